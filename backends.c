@@ -0,0 +1,102 @@
+/*
+ * backends.c - Registry of the allocator packages linked into the driver.
+ *
+ * mm.c exports the mm_* names, mm-naive.c the naive_* names (it is built
+ * with its own aliases for that reason), and libc is wrapped as is.
+ */
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mm.h"
+#include "backends.h"
+
+/* mm-naive.c, as compiled for the driver */
+extern int naive_init(void);
+extern void *naive_malloc(size_t size);
+extern void naive_free(void *ptr);
+extern void *naive_realloc(void *ptr, size_t size);
+extern void *naive_calloc(size_t nmemb, size_t size);
+extern void *naive_memalign(size_t alignment, size_t size);
+extern void naive_free_sized(void *ptr, size_t size);
+extern size_t naive_malloc_usable_size(void *ptr);
+extern size_t naive_malloc_batch(size_t size, size_t n, void **out);
+extern void naive_free_batch(void **ptrs, size_t n);
+extern int naive_checkheap(int verbose);
+
+/*
+ * libc needs no initialization and has no heap checker
+ */
+static int libc_init(void)
+{
+    return 0;
+}
+
+static void *libc_memalign(size_t alignment, size_t size)
+{
+    void *p;
+
+    if (posix_memalign(&p, alignment, size) != 0)
+        return NULL;
+    return p;
+}
+
+/* free_sized is only in C23 libraries */
+static void libc_free_sized(void *ptr, size_t size __attribute__((unused)))
+{
+    free(ptr);
+}
+
+/* libc has no batch calls, so they are loops */
+static size_t libc_malloc_batch(size_t size, size_t n, void **out)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        if ((out[i] = malloc(size)) == NULL)
+            break;
+    return i;
+}
+
+static void libc_free_batch(void **ptrs, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        free(ptrs[i]);
+}
+
+static int libc_checkheap(int verbose __attribute__((unused)))
+{
+    return 0;
+}
+
+const mm_backend_t mm_backends[] = {
+    { "mm", "segregated free lists (mm.c)", 1,
+      mm_init, mm_malloc, mm_free, mm_realloc, mm_calloc, mm_memalign,
+      mm_free_sized, mm_malloc_usable_size, mm_malloc_batch, mm_free_batch,
+      mm_checkheap },
+    { "naive", "bump pointer, never frees (mm-naive.c)", 1,
+      naive_init, naive_malloc, naive_free, naive_realloc, naive_calloc,
+      naive_memalign, naive_free_sized, naive_malloc_usable_size,
+      naive_malloc_batch, naive_free_batch, naive_checkheap },
+    { "libc", "the C library malloc", 0,
+      libc_init, malloc, free, realloc, calloc, libc_memalign,
+      libc_free_sized, malloc_usable_size, libc_malloc_batch,
+      libc_free_batch, libc_checkheap },
+    { NULL, NULL, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      NULL, NULL }
+};
+
+/*
+ * find_backend - Look up a backend by name
+ */
+const mm_backend_t *find_backend(const char *name)
+{
+    const mm_backend_t *b;
+
+    for (b = mm_backends; b->name != NULL; b++)
+        if (strcmp(b->name, name) == 0)
+            return b;
+    return NULL;
+}
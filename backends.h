@@ -0,0 +1,36 @@
+/*
+ * backends.h - The allocator packages that the driver can evaluate.
+ *
+ * Each package is reached through a table of function pointers, so one
+ * run of the driver can compare several of them on the same traces.
+ */
+#ifndef __BACKENDS_H_
+#define __BACKENDS_H_
+
+#include <stddef.h>
+
+typedef struct {
+    const char *name;      /* name used to select it with mdriver -b */
+    const char *descr;     /* one-line description for the usage message */
+    int uses_memlib;       /* heap lives in memlib, so the driver can check
+                              payload extents and measure utilization */
+    int (*init)(void);
+    void *(*malloc)(size_t size);
+    void (*free)(void *ptr);
+    void *(*realloc)(void *ptr, size_t size);
+    void *(*calloc)(size_t nmemb, size_t size);
+    void *(*memalign)(size_t alignment, size_t size);
+    void (*free_sized)(void *ptr, size_t size);
+    size_t (*usable_size)(void *ptr);
+    size_t (*malloc_batch)(size_t size, size_t n, void **out);
+    void (*free_batch)(void **ptrs, size_t n);
+    int (*checkheap)(int verbose); /* problems found */
+} mm_backend_t;
+
+/* All known backends, terminated by an entry with a NULL name */
+extern const mm_backend_t mm_backends[];
+
+/* Look up a backend by name; NULL if there is no such backend */
+const mm_backend_t *find_backend(const char *name);
+
+#endif /* __BACKENDS_H_ */
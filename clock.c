@@ -6,9 +6,12 @@
  * May not be used, modified, or copied without permission.
  */
 
+#define _GNU_SOURCE
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/times.h>
 #include "clock.h"
@@ -33,15 +36,49 @@
 static unsigned cyc_hi = 0;
 static unsigned cyc_lo = 0;
 
+/* Does this processor have the rdtscp instruction? (-1 = not probed yet) */
+static int have_rdtscp = -1;
+
+/* Probe CPUID leaf 0x80000001 for rdtscp (EDX bit 27) */
+static int probe_rdtscp(void)
+{
+    unsigned a, b, c, d;
+
+    asm volatile("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d)
+                 : "a" (0x80000000));
+    if (a < 0x80000001)
+        return 0;
+    asm volatile("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d)
+                 : "a" (0x80000001));
+    return (d >> 27) & 1;
+}
 
 /* Set *hi and *lo to the high and low order bits  of the cycle counter.  
-   Implementation requires assembly code to use the rdtsc instruction. */
+   Implementation requires assembly code to use the rdtsc instruction. 
+   The leading lfence keeps earlier instructions from drifting past
+   the read. */
 void access_counter(unsigned *hi, unsigned *lo)
 {
-    asm("rdtsc; movl %%edx,%0; movl %%eax,%1"   /* Read cycle counter */
-        : "=r" (*hi), "=r" (*lo)                /* and move results to */
-        : /* No input */                        /* the two outputs */
-        : "%edx", "%eax");
+    asm volatile("lfence; rdtsc; movl %%edx,%0; movl %%eax,%1"
+                 : "=r" (*hi), "=r" (*lo)
+                 : /* No input */
+                 : "%edx", "%eax", "memory");
+}
+
+/* Closing read: rdtscp waits for all earlier instructions to retire and
+   the trailing lfence keeps later ones from starting before the read. */
+static void access_counter_end(unsigned *hi, unsigned *lo)
+{
+    if (have_rdtscp < 0)
+        have_rdtscp = probe_rdtscp();
+    if (have_rdtscp) {
+        asm volatile("rdtscp; lfence; movl %%edx,%0; movl %%eax,%1"
+                     : "=r" (*hi), "=r" (*lo)
+                     : /* No input */
+                     : "%edx", "%eax", "%ecx", "memory");
+    } else {
+        access_counter(hi, lo);
+    }
 }
 
 /* Record the current value of the cycle counter. */
@@ -58,7 +95,7 @@ double get_counter()
     double result;
 
     /* Get cycle counter */
-    access_counter(&ncyc_hi, &ncyc_lo);
+    access_counter_end(&ncyc_hi, &ncyc_lo);
 
     /* Do double precision subtraction */
     lo = ncyc_lo - cyc_lo;
@@ -70,6 +107,36 @@ double get_counter()
     }
     return result;
 }
+
+/*
+ * counter_khz - Rate of the invariant TSC as reported by the kernel
+ * (sysfs) or by the processor itself (CPUID leaf 0x15). Returns 0 if
+ * neither source knows it.
+ */
+static double counter_khz(void)
+{
+    FILE *fp;
+    double khz = 0.0;
+    unsigned a, b, c, d;
+
+    if ((fp = fopen("/sys/devices/system/cpu/cpu0/tsc_freq_khz", "r"))) {
+        if (fscanf(fp, "%lf", &khz) != 1)
+            khz = 0.0;
+        fclose(fp);
+        if (khz > 0.0)
+            return khz;
+    }
+
+    asm volatile("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (0));
+    if (a < 0x15)
+        return 0.0;
+    /* EAX:EBX is the TSC / crystal ratio, ECX the crystal rate in Hz */
+    asm volatile("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d)
+                 : "a" (0x15), "c" (0));
+    if (a == 0 || b == 0 || c == 0)
+        return 0.0;
+    return (double)c * b / a / 1e3;
+}
 /* $end x86cyclecounter */
 
 #elif defined(__alpha)
@@ -134,6 +201,12 @@ double get_counter()
     return result;
 }
 
+/* The Alpha has no way to ask for the counter rate */
+static double counter_khz(void)
+{
+    return 0.0;
+}
+
 #else
 
 /****************************************************************
@@ -159,6 +232,11 @@ double get_counter()
     printf("Please choose another timing package in config.h.\n");
     exit(1);
 }
+
+static double counter_khz(void)
+{
+    return 0.0;
+}
 #endif
 
 
@@ -181,42 +259,79 @@ double ovhd()
 }
 
 /* $begin mhz */
-/* Get the clock rate from /proc */
-double mhz_full(int verbose, int sleeptime __attribute__((unused)))
+/*
+ * mhz_full - Determine the rate of the cycle counter. The invariant
+ * TSC ticks at a fixed rate that the kernel or the processor can tell
+ * us directly; otherwise time the counter against CLOCK_MONOTONIC_RAW
+ * for sleeptime milliseconds. (The "cpu MHz" line in /proc/cpuinfo is
+ * the current core clock, which is not the counter rate on machines
+ * that scale their frequency.)
+ */
+double mhz_full(int verbose, int sleeptime)
 {
-    static char buf[2048];
-
-    FILE *fp = fopen("/proc/cpuinfo", "r");
-    double mhz = 0.0;
+    double rate = counter_khz() / 1e3;
+    double ns;
 
-    while (fgets(buf, 2048, fp)) {
-        if (strstr(buf, "cpu MHz")) {
-            sscanf(buf, "cpu MHz\t: %lf", &mhz);
-            break;
-        }
+    if (rate == 0.0) {
+        start_monoraw_counter();
+        start_counter();
+        do {
+            ns = get_monoraw_counter();
+        } while (ns < sleeptime * 1e6);
+        rate = get_counter() / (get_monoraw_counter() / 1e3);
     }
-    fclose(fp);
-    if (verbose) 
-        printf("Processor clock rate ~= %.1f MHz\n", mhz);
-    return mhz;
-
-#if 0
-    double rate;
-
-    start_counter();
-    sleep(sleeptime);
-    rate = get_counter() / (1e6*sleeptime);
     if (verbose) 
         printf("Processor clock rate ~= %.1f MHz\n", rate);
     return rate;
-#endif
 }
 /* $end mhz */
 
-/* Version using a default sleeptime */
+/* Version using a default calibration time */
 double mhz(int verbose)
 {
-    return mhz_full(verbose, 2);
+    return mhz_full(verbose, 20);
+}
+
+/** Counter based on the raw monotonic clock, in nanoseconds */
+
+static struct timespec mono_start;
+
+void start_monoraw_counter()
+{
+    clock_gettime(CLOCK_MONOTONIC_RAW, &mono_start);
+}
+
+double get_monoraw_counter()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    return (now.tv_sec - mono_start.tv_sec) * 1e9 +
+        (now.tv_nsec - mono_start.tv_nsec);
+}
+
+/*
+ * pin_cpu - Bind the calling thread to one core so that every sample
+ * is taken on the same counter and the same caches. A negative cpu
+ * means the core we are running on right now. Returns the core, or -1
+ * if the scheduler refused.
+ */
+int pin_cpu(int cpu, int verbose)
+{
+    cpu_set_t set;
+
+    if (cpu < 0 && (cpu = sched_getcpu()) < 0)
+        return -1;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+        if (verbose)
+            printf("Could not pin to cpu %d, timing unpinned\n", cpu);
+        return -1;
+    }
+    if (verbose)
+        printf("Pinned to cpu %d\n", cpu);
+    return cpu;
 }
 
 /** Special counters that compensate for timer interrupt overhead */
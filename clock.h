@@ -9,12 +9,22 @@ double get_counter();
 /* Measure overhead for counter */
 double ovhd();
 
-/* Determine clock rate of processor (using a default sleeptime) */
+/* Determine clock rate of processor (using a default calibration time) */
 double mhz(int verbose);
 
-/* Determine clock rate of processor, having more control over accuracy */
+/* Determine clock rate of processor, calibrating for sleeptime ms
+   if the kernel does not know the counter rate */
 double mhz_full(int verbose, int sleeptime);
 
+/** Counter based on CLOCK_MONOTONIC_RAW; counts nanoseconds */
+
+void start_monoraw_counter();
+
+double get_monoraw_counter();
+
+/* Bind the calling thread to a core (cpu < 0: the current one) */
+int pin_cpu(int cpu, int verbose);
+
 /** Special counters that compensate for timer interrupt overhead */
 
 void start_comp_counter();
@@ -32,6 +32,8 @@
     "alaska.rep", \
     "amptjp.rep", \
     "bash.rep", \
+    "batch.rep", \
+    "batch-loop.rep", \
     "boat.rep",\
     "cccp.rep", \
     "chrome.rep", \
@@ -42,12 +44,14 @@
     "exhaust.rep", \
     "firefox.rep", \
     "firefox-reddit.rep", \
+    "free-sized.rep", \
     "hostname.rep", \
     "login.rep", \
     "lrucd.rep", \
     "ls.rep", \
     "malloc.rep", \
     "malloc-free.rep", \
+    "memalign.rep", \
     "needle.rep", \
     "nlydf.rep", \
     "perl.rep", \
@@ -102,20 +106,46 @@
 #define UTIL_WEIGHT .61
 
 /*
- * Alignment requirement in bytes (either 4 or 8)
+ * Alignment requirement in bytes: 8, or MM_ALIGNMENT if mm.c is built
+ * with it (make MMFLAGS=-DMM_ALIGNMENT=16)
  */
-#define ALIGNMENT 8
+#ifndef MM_ALIGNMENT
+#define MM_ALIGNMENT 8
+#endif
+#define ALIGNMENT MM_ALIGNMENT
 
 /*
- * Maximum heap size in bytes
+ * Maximum heap size in bytes. This is only address space until the heap
+ * grows into it; change it at run time with mem_set_max_heap (mdriver -H).
  */
-#define MAX_HEAP (100*(1<<20))  /* 100 MB */
+#ifndef MAX_HEAP
+#define MAX_HEAP ((size_t)16 << 30)  /* 16 GB */
+#endif
+
+/*
+ * memlib reserves MAX_HEAP bytes of address space up front, and makes
+ * it usable COMMIT_SIZE bytes at a time as the heap grows into it
+ */
+#define COMMIT_SIZE (1<<20)  /* 1 MB */
+
+/*
+ * Huge page size. A heap backed by huge pages (mdriver -P) starts on a
+ * huge page boundary and is committed in whole huge pages.
+ */
+#define HUGE_PAGE (1<<21)  /* 2 MB */
 
 /*****************************************************************************
  * Set exactly one of these USE_xxx constants to "1" to select a timing method
  *****************************************************************************/
 #define USE_FCYC   1   /* cycle counter w/K-best scheme (x86 & Alpha only) */
+#define USE_MONORAW 0  /* CLOCK_MONOTONIC_RAW w/K-best scheme (Linux) */
 #define USE_ITIMER 0   /* interval timer (any Unix box) */
 #define USE_GETTOD 0   /* gettimeofday (any Unix box) */
 
+/*
+ * Core that the K-best timers pin the driver to; -1 means whichever
+ * core the driver happens to start on
+ */
+#define PIN_CPU -1
+
 #endif /* __CONFIG_H */
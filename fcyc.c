@@ -7,6 +7,7 @@
  * Uses the cycle timer routines in clock.c to estimate the
  * the time in CPU cycles for a function f.
  */
+#include <math.h>
 #include <stdlib.h>
 #include <sys/times.h>
 #include <stdio.h>
@@ -36,6 +37,15 @@ static int *cache_buf = NULL;
 static double *values = NULL;
 static int samplecount = 0;
 
+/* Running sums over every sample, for the standard deviation */
+static double sample_sum = 0;
+static double sample_sumsq = 0;
+static double last_stddev = 0;
+
+/* Counter used when not compensating; see set_fcyc_counter */
+static counter_start_funct counter_start = start_counter;
+static counter_get_funct counter_get = get_counter;
+
 /* for debugging only */
 #define KEEP_VALS 0
 #define KEEP_SAMPLES 0
@@ -59,6 +69,8 @@ static void init_sampler()
     samples = calloc(maxsamples+kbest, sizeof(double));
 #endif
     samplecount = 0;
+    sample_sum = 0;
+    sample_sumsq = 0;
 }
 
 /* 
@@ -77,6 +89,8 @@ static void add_sample(double val)
 #if KEEP_SAMPLES
     samples[samplecount] = val;
 #endif
+    sample_sum += val;
+    sample_sumsq += val * val;
     samplecount++;
     /* Insertion sort */
     while (pos > 0 && values[pos-1] > values[pos]) {
@@ -145,9 +159,9 @@ double fcyc(test_funct f, void *argp)
 	    double cyc;
 	    if (clear_cache)
 		clear();
-	    start_counter();
+	    counter_start();
 	    f(argp);
-	    cyc = get_counter();
+	    cyc = counter_get();
 	    add_sample(cyc);
 	} while (!has_converged() && samplecount < maxsamples);
     }
@@ -160,6 +174,11 @@ double fcyc(test_funct f, void *argp)
     }
 #endif
     result = values[0];
+    {
+	double mean = sample_sum / samplecount;
+	double var = sample_sumsq / samplecount - mean * mean;
+	last_stddev = var > 0 ? sqrt(var) : 0;
+    }
 #if !KEEP_VALS
     free(values); 
     values = NULL;
@@ -168,10 +187,31 @@ double fcyc(test_funct f, void *argp)
 }
 
 
+/*
+ * fcyc_stddev - Standard deviation of all the samples taken by the
+ *     most recent call to fcyc (not just the K best)
+ */
+double fcyc_stddev(void)
+{
+    return last_stddev;
+}
+
+
 /*************************************************************
  * Set the various parameters used by the measurement routines 
  ************************************************************/
 
+/* 
+ * set_fcyc_counter - Use a different counter when not compensating
+ *     for timer interrupts.
+ *     Default = start_counter/get_counter (cycle counter)
+ */
+void set_fcyc_counter(counter_start_funct start, counter_get_funct get)
+{
+    counter_start = start;
+    counter_get = get;
+}
+
 /* 
  * set_fcyc_clear_cache - When set, will run code to clear cache 
  *     before each measurement. 
@@ -13,10 +13,24 @@ typedef void (*test_funct)(void *);
 /* Compute number of cycles used by test function f */
 double fcyc(test_funct f, void* argp);
 
+/* Standard deviation of all samples taken by the last call to fcyc */
+double fcyc_stddev(void);
+
 /*********************************************************
  * Set the various parameters used by measurement routines 
  *********************************************************/
 
+/* The counter that fcyc reads around each sample */
+typedef void (*counter_start_funct)(void);
+typedef double (*counter_get_funct)(void);
+
+/* 
+ * set_fcyc_counter - Use a different counter when not compensating
+ *     for timer interrupts.
+ *     Default = start_counter/get_counter (cycle counter)
+ */
+void set_fcyc_counter(counter_start_funct start, counter_get_funct get);
+
 /* 
  * set_fcyc_clear_cache - When set, will run code to clear cache 
  *     before each measurement. 
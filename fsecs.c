@@ -9,6 +9,7 @@
 #include "config.h"
 
 static double Mhz;  /* estimated CPU clock frequency */
+static double sdev; /* standard deviation of the last fsecs (secs) */
 
 extern int verbose; /* -v option in mdriver.c */
 
@@ -19,17 +20,31 @@ void init_fsecs(void)
 {
     Mhz = 0; /* keep gcc -Wall happy */
 
-#if USE_FCYC
-    if (verbose)
-	printf("Measuring performance with a cycle counter.\n");
+#if USE_FCYC || USE_MONORAW
+    /* 
+     * Every sample runs on one core, so the serialized counter reads are
+     * comparable and timer interrupts land in the samples the K-best
+     * scheme throws away; no need to calibrate for tick compensation.
+     */
+    pin_cpu(PIN_CPU, verbose > 1);
 
     /* set key parameters for the fcyc package */
     set_fcyc_maxsamples(20); 
     set_fcyc_clear_cache(1);
-    set_fcyc_compensate(1);
+    set_fcyc_compensate(0);
     set_fcyc_epsilon(0.01);
     set_fcyc_k(3);
+#endif
+
+#if USE_FCYC
+    if (verbose)
+	printf("Measuring performance with a cycle counter.\n");
     Mhz = mhz(verbose > 0);
+#elif USE_MONORAW
+    if (verbose)
+	printf("Measuring performance with CLOCK_MONOTONIC_RAW.\n");
+    set_fcyc_counter(start_monoraw_counter, get_monoraw_counter);
+    Mhz = 1e3; /* the counter ticks in nanoseconds */
 #elif USE_ITIMER
     if (verbose)
 	printf("Measuring performance with the interval timer.\n");
@@ -44,8 +59,9 @@ void init_fsecs(void)
  */
 double fsecs(fsecs_test_funct f, void *argp) 
 {
-#if USE_FCYC
+#if USE_FCYC || USE_MONORAW
     double cycles = fcyc(f, argp);
+    sdev = fcyc_stddev()/(Mhz*1e6);
     return cycles/(Mhz*1e6);
 #elif USE_ITIMER
     return ftimer_itimer(f, argp, 10);
@@ -55,3 +71,12 @@ double fsecs(fsecs_test_funct f, void *argp)
 }
 
 
+
+/*
+ * fsecs_stddev - Standard deviation (in seconds) of the samples behind
+ * the last fsecs result; 0 for the timers that only report an average
+ */
+double fsecs_stddev(void)
+{
+    return sdev;
+}
@@ -13,16 +13,23 @@
 #include <setjmp.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/resource.h>
 
 
 #include "mm.h"
 #include "memlib.h"
+#include "memops.h"
+#include "backends.h"
+#include "trace.h"
 #include "fsecs.h"
+#include "clock.h"
+#include "perfctr.h"
 #include "config.h"
 
 /**********************
@@ -30,18 +37,19 @@
  **********************/
 
 /* Misc */
-#define MAXLINE     1024 /* max string size */
-#define HDRLINES       4 /* number of header lines in a trace file */
+#define MAXBACKENDS    8 /* max number of backends in one run */
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
 
 /* Returns true if p is ALIGNMENT-byte aligned */
 #define IS_ALIGNED(p)  ((((unsigned long)(p)) % ALIGNMENT) == 0)
 
-/* weights */
-#define WNONE 0
-#define WALL 1
-#define WUTIL 2
-#define WPERF 3
+/* Locality mode: ops between sweeps over the live blocks */
+#define TOUCH_PERIOD  64
+#define CACHE_LINE    64
+
+/* Sweep orders in locality mode */
+#define ORDER_ALLOC   0
+#define ORDER_RANDOM  1
 
 /******************************
  * The key compound data types
@@ -62,26 +70,6 @@ typedef struct range_t {
     int index;             /* same index as free; for debugging */
 } range_t;
 
-/* Characterizes a single trace operation (allocator request) */
-typedef struct {
-    enum { ALLOC, FREE, REALLOC } type; /* type of request */
-    int index;                        /* index for free() to use later */
-    size_t size;                      /* byte size of alloc/realloc request */
-} traceop_t;
-
-/* Holds the information for one trace file*/
-typedef struct {
-    char filename[MAXLINE];
-    int ignore_ranges;   /* don't check ranges (i.e. this is too big) */
-    int num_ids;         /* number of alloc/realloc ids */
-    int num_ops;         /* number of distinct requests */
-    int weight;          /* weight for this trace (unused) */
-    traceop_t *ops;      /* array of requests */
-    char **blocks;       /* array of ptrs returned by malloc/realloc... */
-    size_t *block_sizes; /* ... and a corresponding array of payload sizes */
-    int *block_rand_base;/* index into random_data, if debug is on */
-} trace_t;
-
 /*
  * Holds the params to the xxx_speed functions, which are timed by fcyc.
  * This struct is necessary because fcyc accepts only a pointer array
@@ -99,14 +87,25 @@ typedef struct {
     int weight;
     double ops;      /* number of ops (malloc/free/realloc) in the trace */
 
-    /* run-time stats defined for both libc and student */
+    /* run-time stats defined for every backend */
     int valid;       /* was the trace processed correctly by the allocator? */
     double secs;     /* number of secs needed to run the trace */
+    double sdev;     /* standard deviation of the timing samples (secs) */
 
     /* defined only for the student malloc package */
-    double util;     /* space utilization for this trace (always 0 for libc) */
+    double util;     /* space utilization for this trace (0 unless the
+                        backend uses memlib) */
+    long faults;     /* page faults in the first replay, on a fresh heap,
+                        except those memlib took prefaulting */
 
     /* Note: secs and util are only defined if valid is true */
+
+    /* defined only in locality mode (-L); misses are -1 if the machine
+       has no usable cache-miss counter */
+    double alloc_cyc;   /* cycles spent in the allocator */
+    double alloc_miss;  /* cache misses in the allocator */
+    double app_cyc[2];  /* cycles spent touching payloads, per order */
+    double app_miss[2]; /* cache misses touching payloads, per order */
 } stats_t;
 
 
@@ -131,12 +130,18 @@ static randint_t random_data[RANDOM_DATA_LEN];
 static enum { DBG_NONE, DBG_CHEAP, DBG_EXPENSIVE } debug_mode = DBG_CHEAP;
 
 int verbose = 1;        /* global flag for verbose output */
-static int errors = 0;  /* number of errs found when running student malloc */
+static int errors = 0;  /* number of errs found when running the backend */
+
+/* The allocator package being evaluated */
+static const mm_backend_t *backend;
 int onetime_flag = 0;
 
 /* by default, no timeouts */
 static int set_timeout = 0;
 
+/* fraction of live blocks read every TOUCH_PERIOD ops (-L); 0 = off */
+static double touch_frac = 0;
+
 
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
@@ -153,8 +158,10 @@ char autoresult[MAXLINE]; /* autoresult string */
  *********************/
 
 /* these functions manipulate range lists */
-static int add_range(range_t **ranges, char *lo, int size,
+static int add_range(range_t **ranges, char *lo, size_t size,
                      const trace_t *trace, int opnum, int index);
+static int add_usable_range(range_t **ranges, char *lo, size_t size,
+                            const trace_t *trace, int opnum, int index);
 static void remove_range(range_t **ranges, char *lo);
 static void clear_ranges(range_t **ranges);
 
@@ -163,24 +170,25 @@ static void init_random_data(void);
 static void check_index(const trace_t *trace, int opnum, int index);
 static void randomize_block(trace_t *trace, int index);
 
-/* These functions read, allocate, and free storage for traces */
-static trace_t *read_trace(stats_t *stats, const char *tracedir,
-                           const char *filename);
-static void reinit_trace(trace_t *trace);
-static void free_trace(trace_t *trace);
-
-/* Routines for evaluating the correctness and speed of libc malloc */
-static int eval_libc_valid(trace_t *trace);
-static void eval_libc_speed(void *ptr);
-
 /* Routines for evaluating correctnes, space utilization, and speed
-   of the student's malloc package in mm.c */
+   of the selected malloc package */
 static int eval_mm_valid(trace_t *trace, range_t **ranges);
 static double eval_mm_util(trace_t *trace, int tracenum);
 static void eval_mm_speed(void *ptr);
+static void eval_mm_locality(trace_t *trace, stats_t *stats);
+
+/* These functions pick the backends to evaluate */
+static int add_backends(const mm_backend_t **backends, int n,
+                        const char *list);
+static int has_backend(const mm_backend_t **backends, int n,
+                       const char *name);
 
 /* Various helper routines */
-static void printresults(int n, stats_t *stats);
+static long page_faults(void);
+static void printresults(int n, stats_t *stats, int nerrors);
+static void printlocality(int n, stats_t *stats);
+static void printcomparison(int n, int nbackends,
+                            const mm_backend_t **backends, stats_t **stats);
 static void usage(void);
 static void malloc_error(const trace_t *trace, int opnum, const char *fmt, ...)
     __attribute__((format(printf, 3,4)));
@@ -217,15 +225,20 @@ static void run_tests(int num_tracefiles, const char *tracedir,
         }
 
         trace_t *trace;
-        trace = read_trace(&mm_stats[i], tracedir, tracefiles[i]);
+        if (verbose > 1)
+            printf("Reading tracefile: %s\n", tracefiles[i]);
+        trace = read_trace(tracedir, tracefiles[i]);
         strcpy(mm_stats[i].filename, trace->filename);
+        mm_stats[i].weight = trace->weight;
         mm_stats[i].ops = trace->num_ops;
         if(timed_out) {
             mm_stats[i].valid = 0;
         } else {
             if (verbose > 1)
-                printf("Checking mm_malloc for correctness, ");
+                printf("Checking %s malloc for correctness, ", backend->name);
+            mm_stats[i].faults = page_faults();
             mm_stats[i].valid = eval_mm_valid(trace, &ranges);
+            mm_stats[i].faults = page_faults() - mm_stats[i].faults;
 
             if (onetime_flag) {
                 free_trace(trace);
@@ -233,14 +246,22 @@ static void run_tests(int num_tracefiles, const char *tracedir,
             }
         }
         if (mm_stats[i].valid) {
-            if (verbose > 1)
-                printf("efficiency, ");
-            mm_stats[i].util = eval_mm_util(trace, i);
+            if (backend->uses_memlib) {
+                if (verbose > 1)
+                    printf("efficiency, ");
+                mm_stats[i].util = eval_mm_util(trace, i);
+            }
             speed_params->trace = trace;
             speed_params->ranges = ranges;
             if (verbose > 1)
                 printf("and performance.\n");
             mm_stats[i].secs = fsecs(eval_mm_speed, speed_params);
+            mm_stats[i].sdev = fsecs_stddev();
+            if (touch_frac > 0) {
+                if (verbose > 1)
+                    printf("Replaying with payload accesses.\n");
+                eval_mm_locality(trace, &mm_stats[i]);
+            }
         }
 
         free_trace(trace);
@@ -261,10 +282,17 @@ int main(int argc, char **argv)
     int num_tracefiles = 0;    /* the number of traces in that array */
 
     range_t *ranges = NULL;    /* keeps track of block extents for one trace */
-    stats_t *libc_stats = NULL;/* libc stats for each trace */
-    stats_t *mm_stats = NULL;  /* mm (i.e. student) stats for each trace */
+    stats_t *mm_stats = NULL;  /* stats of the primary backend for each trace */
     speed_t speed_params;      /* input parameters to the xx_speed routines */
 
+    /* backends to evaluate, in order, with their stats for each trace */
+    const mm_backend_t *backends[MAXBACKENDS];
+    stats_t *backend_stats[MAXBACKENDS] = { NULL };
+    int backend_errors[MAXBACKENDS] = { 0 };
+    int num_backends = 0;
+    int primary = 0;      /* backend the performance index is computed for */
+    int b;
+
     int run_libc = 0;     /* If set, run libc malloc (set by -l) */
     int autograder = 0;   /* if set then called by autograder (-A) */
 
@@ -280,9 +308,13 @@ int main(int argc, char **argv)
     /*
      * Read and interpret the command line arguments
      */
-    while ((c = getopt(argc, argv, "d:f:c:s:t:v:hVAlD")) != EOF) {
+    while ((c = getopt(argc, argv, "b:d:f:c:s:t:v:F:H:L:P:hVAlD")) != EOF) {
         switch (c) {
 
+        case 'b': /* Backends to evaluate: name[,name...] or "all" */
+            num_backends = add_backends(backends, num_backends, optarg);
+            break;
+
         case 'A': /* Hidden Autolab driver argument */
             autograder = 1;
             break;
@@ -314,6 +346,51 @@ int main(int argc, char **argv)
                 strcat(tracedir, "/"); /* path always ends with "/" */
             break;
 
+        case 'F': /* Prefault the heap ahead of the brk */
+            if (strcmp(optarg, "none") == 0)
+                mem_set_prefault(MEM_PREFAULT_NONE);
+            else if (strcmp(optarg, "populate") == 0)
+                mem_set_prefault(MEM_PREFAULT_POPULATE);
+            else if (strcmp(optarg, "touch") == 0)
+                mem_set_prefault(MEM_PREFAULT_TOUCH);
+            else if (strcmp(optarg, "lock") == 0)
+                mem_set_prefault(MEM_PREFAULT_LOCK);
+            else
+                app_error("-F takes none, populate, touch or lock\n");
+            break;
+
+        case 'H': /* Reserve this many MB for each heap */
+            {
+                char *end;
+                unsigned long long mb = strtoull(optarg, &end, 0);
+
+                /* A heap of 1 MB holds the seg lists and the prologue
+                   that mm_init lays out, and then some */
+                if (*optarg == '-' || *end != '\0' || mb < 1 ||
+                    mb > (SIZE_MAX >> 20))
+                    app_error("-H takes a heap size of 1 to %zu MB\n",
+                              (size_t)(SIZE_MAX >> 20));
+                mem_set_max_heap((size_t)mb << 20);
+            }
+            break;
+
+        case 'P': /* Pages that back the heap */
+            if (strcmp(optarg, "small") == 0)
+                mem_set_pages(MEM_PAGES_SMALL);
+            else if (strcmp(optarg, "thp") == 0)
+                mem_set_pages(MEM_PAGES_THP);
+            else if (strcmp(optarg, "hugetlb") == 0)
+                mem_set_pages(MEM_PAGES_HUGETLB);
+            else
+                app_error("-P takes small, thp or hugetlb\n");
+            break;
+
+        case 'L': /* Locality mode: touch this fraction of live blocks */
+            touch_frac = atof(optarg);
+            if (touch_frac <= 0 || touch_frac > 1)
+                app_error("-L takes a fraction in (0, 1]\n");
+            break;
+
         case 'l': /* Run libc malloc */
             run_libc = 1;
             break;
@@ -354,12 +431,28 @@ int main(int argc, char **argv)
         printf("Using default tracefiles in %s\n", tracedir);
     }
 
+    if (num_backends == 0)
+        num_backends = add_backends(backends, num_backends, "mm");
+
+    /* libc goes first, as the baseline the other packages are read against */
+    if (run_libc && !has_backend(backends, num_backends, "libc")) {
+        if (num_backends == MAXBACKENDS)
+            app_error("Too many backends (at most %d)\n", MAXBACKENDS);
+        memmove(&backends[1], &backends[0],
+                num_backends * sizeof(backends[0]));
+        backends[0] = find_backend("libc");
+        num_backends++;
+        primary = 1;
+    }
+
     if(debug_mode != DBG_NONE) {
         init_random_data();
     }
 
     /* Initialize the timing package */
     init_fsecs();
+    if (touch_frac > 0 && perfctr_open() < 0 && verbose)
+        printf("No cache-miss counter; locality mode reports cycles only\n");
 
     /* Initialize the timeout */
     if (set_timeout > 0) {
@@ -368,73 +461,55 @@ int main(int argc, char **argv)
     }
 
     /*
-     * Optionally run and evaluate the libc malloc package
+     * Run and evaluate each of the selected malloc packages
      */
-    if (run_libc) {
+    for (b = 0; b < num_backends; b++) {
+        backend = backends[b];
         if (verbose > 1)
-            printf("\nTesting libc malloc\n");
+            printf("\nTesting %s malloc\n", backend->name);
 
-        /* Allocate libc stats array, with one stats_t struct per tracefile */
-        libc_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
-        if (libc_stats == NULL)
-            unix_error("libc_stats calloc in main failed");
+        /* Allocate the stats array, with one stats_t struct per tracefile */
+        backend_stats[b] = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+        if (backend_stats[b] == NULL)
+            unix_error("stats calloc in main failed");
 
-        /* Evaluate the libc malloc package using the K-best scheme */
-        for (i=0; i < num_tracefiles; i++) {
-            trace_t *trace = read_trace(&libc_stats[i], tracedir, tracefiles[i]);
+        errors = 0;
+        run_tests(num_tracefiles, tracedir, tracefiles, backend_stats[b],
+                  ranges, &speed_params);
+        backend_errors[b] = errors;
 
-            if (verbose > 1)
-                printf("Checking libc malloc for correctness, ");
-            libc_stats[i].valid = eval_libc_valid(trace);
-            if (libc_stats[i].valid) {
-                speed_params.trace = trace;
-                if (verbose > 1)
-                    printf("and performance.\n");
-                libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
-            }
-            free_trace(trace);
-        }
-
-        /* Display the libc results in a compact table */
+        /* Display the results in a compact table */
         if (verbose) {
-            printf("\nResults for libc malloc:\n");
-            printresults(num_tracefiles, libc_stats);
-        }
-    }
-
-    /*
-     * Always run and evaluate the student's mm package
-     */
-    if (verbose > 1)
-        printf("\nTesting mm malloc\n");
-
-    /* Allocate the mm stats array, with one stats_t struct per tracefile */
-    mm_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
-    if (mm_stats == NULL)
-        unix_error("mm_stats calloc in main failed");
-
-    run_tests(num_tracefiles, tracedir, tracefiles, mm_stats,
-              ranges, &speed_params);
-
-
-    /* Display the mm results in a compact table */
-    if (verbose) {
-        if (onetime_flag) {
-            printf("\n\ncorrectness check finished, by running tracefile \"%s\".\n", tracefiles[num_tracefiles-1]);
-            if (mm_stats[num_tracefiles-1].valid) {
-                printf(" => correct.\n\n");
+            if (onetime_flag) {
+                printf("\n\ncorrectness check finished, by running tracefile \"%s\".\n", tracefiles[num_tracefiles-1]);
+                if (backend_stats[b][num_tracefiles-1].valid) {
+                    printf(" => correct.\n\n");
+                } else {
+                    printf(" => incorrect.\n\n");
+                }
             } else {
-                printf(" => incorrect.\n\n");
+                printf("\nResults for %s malloc:\n", backend->name);
+                printresults(num_tracefiles, backend_stats[b], errors);
+                printf("\n");
+                if (touch_frac > 0) {
+                    printlocality(num_tracefiles, backend_stats[b]);
+                    printf("\n");
+                }
             }
-        } else {
-            printf("\nResults for mm malloc:\n");
-            printresults(num_tracefiles, mm_stats);
-            printf("\n");
         }
     }
 
+    /* Put the backends next to each other, trace by trace */
+    if (verbose && num_backends > 1 && !onetime_flag)
+        printcomparison(num_tracefiles, num_backends, backends, backend_stats);
+
+    mm_stats = backend_stats[primary];
+    errors = backend_errors[primary];
+    if (num_backends > 1)
+        printf("Perf index for %s malloc:\n", backends[primary]->name);
+
     /*
-     * Accumulate the aggregate statistics for the student's mm package
+     * Accumulate the aggregate statistics for the primary package
      */
     secs = 0;
     ops = 0;
@@ -557,7 +632,7 @@ int main(int argc, char **argv)
  *     size bytes at addr lo. After checking the block for correctness,
  *     we create a range struct for this block and add it to the range list.
  */
-static int add_range(range_t **ranges, char *lo, int size,
+static int add_range(range_t **ranges, char *lo, size_t size,
                      const trace_t *trace, int opnum, int index)
 {
     char *hi = lo + size - 1;
@@ -573,8 +648,9 @@ static int add_range(range_t **ranges, char *lo, int size,
     }
 
     /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
-        (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+    if (backend->uses_memlib &&
+        ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
+         (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi()))) {
         malloc_error(trace, opnum,
                      "Payload (%p:%p) lies outside heap (%p:%p)",
                      lo, hi, mem_heap_lo(), mem_heap_hi());
@@ -612,6 +688,28 @@ static int add_range(range_t **ranges, char *lo, int size,
     return 1;
 }
 
+/*
+ * add_usable_range - add_range for the whole usable size of the block
+ *     at lo, which must be at least the size bytes asked for. The slack
+ *     past them is written over, so a block it overlaps is caught when
+ *     its data is checked.
+ */
+static int add_usable_range(range_t **ranges, char *lo, size_t size,
+                            const trace_t *trace, int opnum, int index)
+{
+    size_t usable = backend->usable_size(lo);
+
+    if (usable < size) {
+        malloc_error(trace, opnum, "Usable size of %p is %zu, not the %zu "
+                     "bytes asked for", lo, usable, size);
+        return 0;
+    }
+    if (add_range(ranges, lo, usable, trace, opnum, index) == 0)
+        return 0;
+    memset(lo + size, 0x5a, usable - size);
+    return 1;
+}
+
 /*
  * remove_range - Free the range record of block whose payload starts at lo
  */
@@ -662,7 +760,7 @@ static void init_random_data(void) {
 
 static void randomize_block(trace_t *traces, int index) {
     size_t size;
-    size_t i;
+    size_t i, off, n;
     randint_t *block;
     int base;
 
@@ -674,8 +772,15 @@ static void randomize_block(trace_t *traces, int index) {
     size = traces->block_sizes[index] / sizeof(*block);
     base = traces->block_rand_base[index];
 
-    for(i = 0; i < size; i++) {
-        block[i] = random_data[(base + i) % RANDOM_DATA_LEN];
+    /* Copy the random data around its ring; a large block is streamed
+       past the cache, piece by piece */
+    for(i = 0; i < size; i += n) {
+        off = (base + i) % RANDOM_DATA_LEN;
+        n = size - i < RANDOM_DATA_LEN - off ? size - i : RANDOM_DATA_LEN - off;
+        if (size * sizeof(*block) >= MEMOPS_NT_MIN)
+            memops_copy_nt(block + i, random_data + off, n * sizeof(*block));
+        else
+            memcpy(block + i, random_data + off, n * sizeof(*block));
     }
 }
 
@@ -707,138 +812,9 @@ static void check_index(const trace_t *trace, int opnum, int index) {
     }
 }
 
-/**********************************************
- * The following routines manipulate tracefiles
- *********************************************/
-
-/*
- * read_trace - read a trace file and store it in memory
- */
-static trace_t *read_trace(stats_t *stats, const char *tracedir,
-                           const char *filename)
-{
-    FILE *tracefile;
-    trace_t *trace;
-    char type[MAXLINE];
-    int index, size;
-    int max_index = 0;
-    int op_index;
-
-    if (verbose > 1)
-        printf("Reading tracefile: %s\n", filename);
-
-    /* Allocate the trace record */
-    if ((trace = (trace_t *) malloc(sizeof(trace_t))) == NULL)
-        unix_error("malloc 1 failed in read_trace");
-
-    /* Read the trace file header */
-    strcpy(trace->filename, tracedir);
-    strcat(trace->filename, filename);
-    if ((tracefile = fopen(trace->filename, "r")) == NULL) {
-        unix_error("Could not open %s in read_trace", trace->filename);
-    }
-    fscanf(tracefile, "%d", &trace->weight);
-    fscanf(tracefile, "%d", &trace->num_ids);
-    fscanf(tracefile, "%d", &trace->num_ops);
-    fscanf(tracefile, "%d", &trace->ignore_ranges);
-
-    if(trace->weight < 0 || trace->weight > 3) {
-        app_error("%s: weight can only be in {0, 1, 2 3}", trace->filename);
-    }
-    if(trace->ignore_ranges != 0 && trace->ignore_ranges != 1) {
-        app_error("%s: ignore-ranges can only be zero or one", trace->filename);
-    }
-
-    /* We'll store each request line in the trace in this array */
-    if ((trace->ops =
-         (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
-        unix_error("malloc 2 failed in read_trace");
-
-    /* We'll keep an array of pointers to the allocated blocks here... */
-    if ((trace->blocks =
-         (char **)calloc(trace->num_ids, sizeof(char *))) == NULL)
-        unix_error("malloc 3 failed in read_trace");
-
-    /* ... along with the corresponding byte sizes of each block */
-    if ((trace->block_sizes =
-         (size_t *)calloc(trace->num_ids,  sizeof(size_t))) == NULL)
-        unix_error("malloc 4 failed in read_trace");
-
-    /* and, if we're debugging, the offset into the random data */
-    if ((trace->block_rand_base =
-         calloc(trace->num_ids, sizeof(*trace->block_rand_base))) == NULL)
-        unix_error("malloc 5 failed in read_trace");
-
-
-    /* read every request line in the trace file */
-    index = 0;
-    op_index = 0;
-    while (fscanf(tracefile, "%s", type) != EOF) {
-        switch(type[0]) {
-        case 'a':
-            fscanf(tracefile, "%u %u", &index, &size);
-            trace->ops[op_index].type = ALLOC;
-            trace->ops[op_index].index = index;
-            trace->ops[op_index].size = size;
-            max_index = (index > max_index) ? index : max_index;
-            break;
-        case 'r':
-            fscanf(tracefile, "%u %u", &index, &size);
-            trace->ops[op_index].type = REALLOC;
-            trace->ops[op_index].index = index;
-            trace->ops[op_index].size = size;
-            max_index = (index > max_index) ? index : max_index;
-            break;
-        case 'f':
-            fscanf(tracefile, "%ud", &index);
-            trace->ops[op_index].type = FREE;
-            trace->ops[op_index].index = index;
-            break;
-        default:
-            app_error("Bogus type character (%c) in tracefile %s\n",
-                      type[0], trace->filename);
-        }
-        op_index++;
-        if(op_index == trace->num_ops) break;
-    }
-    fclose(tracefile);
-    assert(max_index == trace->num_ids - 1);
-    assert(trace->num_ops == op_index);
-
-    /* fill in the stats */
-    strcpy(stats->filename, trace->filename);
-    stats->weight = trace->weight;
-    stats->ops = trace->num_ops;
-
-    return trace;
-}
-
-/*
- * reinit_trace - get the trace ready for another run.
- */
-static void reinit_trace(trace_t *trace)
-{
-    memset(trace->blocks, 0, trace->num_ids * sizeof(*trace->blocks));
-    memset(trace->block_sizes, 0, trace->num_ids * sizeof(*trace->block_sizes));
-    /* block_rand_base is unused if size is zero */
-}
-
-/*
- * free_trace - Free the trace record and the four arrays it points
- *              to, all of which were allocated in read_trace().
- */
-static void free_trace(trace_t *trace)
-{
-    free(trace->ops);         /* free the three arrays... */
-    free(trace->blocks);
-    free(trace->block_sizes);
-    free(trace->block_rand_base);
-    free(trace);              /* and the trace record itself... */
-}
-
 /**********************************************************************
  * The following functions evaluate the correctness, space utilization,
- * and throughput of the libc and mm malloc packages.
+ * and throughput of the selected malloc package.
  **********************************************************************/
 
 /*
@@ -846,7 +822,7 @@ static void free_trace(trace_t *trace)
  */
 static int eval_mm_valid(trace_t *trace, range_t **ranges)
 {
-    int i;
+    int i, k, n;
     int index;
     size_t size;
     char *newp;
@@ -859,7 +835,7 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
     reinit_trace(trace);
 
     /* Call the mm package's init function */
-    if (mm_init() < 0) {
+    if (backend->init() < 0) {
         malloc_error(trace, 0, "mm_init failed.");
         return 0;
     }
@@ -871,9 +847,15 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
 
         if(debug_mode == DBG_EXPENSIVE) {
             range_t *r;
+            int errors;
                         
-            /* Let the students check their own heap */
-            mm_checkheap(verbose);
+            /* Let the students check their own heap; what it finds fails
+               the trace */
+            if ((errors = backend->checkheap(verbose)) > 0) {
+                malloc_error(trace, i, "mm_checkheap found %d problem%s",
+                             errors, errors == 1 ? "" : "s");
+                return 0;
+            }
 
             /* Now check that all our allocated blocks have the right data */
             r = *ranges;
@@ -886,9 +868,22 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
         switch (trace->ops[i].type) {
 
         case ALLOC: /* mm_malloc */
+        case MEMALIGN: /* mm_memalign */
 
             /* Call the student's malloc */
-            if ((p = mm_malloc(size)) == NULL) {
+            if (trace->ops[i].type == MEMALIGN) {
+                p = backend->memalign(trace->ops[i].align, size);
+                if (p == NULL) {
+                    malloc_error(trace, i, "mm_memalign failed.");
+                    return 0;
+                }
+                if ((size_t)p % trace->ops[i].align) {
+                    malloc_error(trace, i, "mm_memalign returned %p, not "
+                                 "aligned to %zu bytes", p,
+                                 trace->ops[i].align);
+                    return 0;
+                }
+            } else if ((p = backend->malloc(size)) == NULL) {
                 malloc_error(trace, i, "mm_malloc failed.");
                 return 0;
             }
@@ -896,9 +891,10 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
             /*
              * Test the range of the new block for correctness and add it
              * to the range list if OK. The block must be  be aligned properly,
-             * and must not overlap any currently allocated block.
+             * and must not overlap any currently allocated block, slack
+             * included.
              */
-            if (add_range(ranges, p, size, trace, i, index) == 0)
+            if (add_usable_range(ranges, p, size, trace, i, index) == 0)
                 return 0;
 
             /* Remember region */
@@ -914,7 +910,7 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
 
             /* Call the student's realloc */
             oldp = trace->blocks[index];
-            newp = mm_realloc(oldp, size);
+            newp = backend->realloc(oldp, size);
             if( (newp == NULL) && (size != 0) ) {
                 malloc_error(trace, i, "mm_realloc failed.");
                 return 0;
@@ -931,7 +927,7 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
 
             /* Check new block for correctness and add it to range list */
             if (size > 0) {
-                if(add_range(ranges, newp, size, trace, i, index) == 0)
+                if(add_usable_range(ranges, newp, size, trace, i, index) == 0)
                     return 0;
             }
 
@@ -959,7 +955,43 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
                 p = trace->blocks[index];
                 remove_range(ranges, p);
             }
-            mm_free(p);
+            backend->free(p);
+            break;
+
+        case FREE_SIZED: /* mm_free_sized */
+            check_index(trace, i, index);
+            if (size != trace->block_sizes[index])
+                app_error("%s: free_sized of block %d with %zu bytes, not "
+                          "the %zu it has\n", trace->filename, index, size,
+                          trace->block_sizes[index]);
+            p = trace->blocks[index];
+            remove_range(ranges, p);
+            backend->free_sized(p, size);
+            break;
+
+        case BATCH_ALLOC: /* mm_malloc_batch */
+            n = trace->ops[i].count;
+            if (backend->malloc_batch(size, n, (void **)&trace->blocks[index])
+                != (size_t)n) {
+                malloc_error(trace, i, "mm_malloc_batch failed.");
+                return 0;
+            }
+            for (k = index; k < index + n; k++) {
+                if (add_usable_range(ranges, trace->blocks[k], size,
+                                     trace, i, k) == 0)
+                    return 0;
+                trace->block_sizes[k] = size;
+                randomize_block(trace, k);
+            }
+            break;
+
+        case BATCH_FREE: /* mm_free_batch */
+            n = trace->ops[i].count;
+            for (k = index; k < index + n; k++) {
+                check_index(trace, i, k);
+                remove_range(ranges, trace->blocks[k]);
+            }
+            backend->free_batch((void **)&trace->blocks[index], n);
             break;
 
         default:
@@ -986,11 +1018,11 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
  */
 static double eval_mm_util(trace_t *trace, int tracenum)
 {
-    int i;
+    int i, k, n;
     int index;
-    int size, newsize, oldsize;
-    int max_total_size = 0;
-    int total_size = 0;
+    size_t size, newsize, oldsize;
+    size_t max_total_size = 0;
+    size_t total_size = 0;
     char *p;
     char *newp, *oldp;
 
@@ -998,17 +1030,21 @@ static double eval_mm_util(trace_t *trace, int tracenum)
 
     /* initialize the heap and the mm malloc package */
     mem_reset_brk();
-    if (mm_init() < 0)
+    if (backend->init() < 0)
         app_error("trace %d: mm_init failed in eval_mm_util", tracenum);
 
     for (i = 0;  i < trace->num_ops;  i++) {
         switch (trace->ops[i].type) {
 
         case ALLOC: /* mm_alloc */
+        case MEMALIGN: /* mm_memalign */
             index = trace->ops[i].index;
             size = trace->ops[i].size;
 
-            if ((p = mm_malloc(size)) == NULL) {
+            p = (trace->ops[i].type == MEMALIGN) ?
+                backend->memalign(trace->ops[i].align, size) :
+                backend->malloc(size);
+            if (p == NULL) {
                 app_error("trace %d: mm_malloc failed in eval_mm_util",
                           tracenum);
             }
@@ -1026,7 +1062,7 @@ static double eval_mm_util(trace_t *trace, int tracenum)
             oldsize = trace->block_sizes[index];
 
             oldp = trace->blocks[index];
-            if ((newp = mm_realloc(oldp,newsize)) == NULL && newsize != 0) {
+            if ((newp = backend->realloc(oldp,newsize)) == NULL && newsize != 0) {
                 app_error("trace %d: mm_realloc failed in eval_mm_util",
                           tracenum);
             }
@@ -1048,11 +1084,39 @@ static double eval_mm_util(trace_t *trace, int tracenum)
                 p = trace->blocks[index];
             }
 
-            mm_free(p);
+            backend->free(p);
 
             total_size -= size;
             break;
 
+        case FREE_SIZED: /* mm_free_sized */
+            index = trace->ops[i].index;
+            size = trace->block_sizes[index];
+            backend->free_sized(trace->blocks[index], size);
+            total_size -= size;
+            break;
+
+        case BATCH_ALLOC: /* mm_malloc_batch */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            n = trace->ops[i].count;
+            if (backend->malloc_batch(size, n, (void **)&trace->blocks[index])
+                != (size_t)n)
+                app_error("trace %d: mm_malloc_batch failed in eval_mm_util",
+                          tracenum);
+            for (k = index; k < index + n; k++)
+                trace->block_sizes[k] = size;
+            total_size += n * size;
+            break;
+
+        case BATCH_FREE: /* mm_free_batch */
+            index = trace->ops[i].index;
+            n = trace->ops[i].count;
+            for (k = index; k < index + n; k++)
+                total_size -= trace->block_sizes[k];
+            backend->free_batch((void **)&trace->blocks[index], n);
+            break;
+
         default:
             app_error("trace %d: Nonexistent request type in eval_mm_util",
                       tracenum);
@@ -1075,14 +1139,15 @@ static double eval_mm_util(trace_t *trace, int tracenum)
  */
 static void eval_mm_speed(void *ptr)
 {
-    int i, index, size, newsize;
+    int i, index;
+    size_t size, newsize;
     char *p, *newp, *oldp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
     reinit_trace(trace);
 
     /* Reset the heap and initialize the mm package */
     mem_reset_brk();
-    if (mm_init() < 0)
+    if (backend->init() < 0)
         app_error("mm_init failed in eval_mm_speed");
 
     /* Interpret each trace request */
@@ -1092,16 +1157,24 @@ static void eval_mm_speed(void *ptr)
         case ALLOC: /* mm_malloc */
             index = trace->ops[i].index;
             size = trace->ops[i].size;
-            if ((p = mm_malloc(size)) == NULL)
+            if ((p = backend->malloc(size)) == NULL)
                 app_error("mm_malloc error in eval_mm_speed");
             trace->blocks[index] = p;
             break;
 
+        case MEMALIGN: /* mm_memalign */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            if ((p = backend->memalign(trace->ops[i].align, size)) == NULL)
+                app_error("mm_memalign error in eval_mm_speed");
+            trace->blocks[index] = p;
+            break;
+
         case REALLOC: /* mm_realloc */
             index = trace->ops[i].index;
             newsize = trace->ops[i].size;
             oldp = trace->blocks[index];
-            if ((newp = mm_realloc(oldp,newsize)) == NULL && newsize != 0)
+            if ((newp = backend->realloc(oldp,newsize)) == NULL && newsize != 0)
                 app_error("mm_realloc error in eval_mm_speed");
             trace->blocks[index] = newp;
             break;
@@ -1113,7 +1186,27 @@ static void eval_mm_speed(void *ptr)
             } else {
                 block = trace->blocks[index];
             }
-            mm_free(block);
+            backend->free(block);
+            break;
+
+        case FREE_SIZED: /* mm_free_sized */
+            index = trace->ops[i].index;
+            backend->free_sized(trace->blocks[index], trace->ops[i].size);
+            break;
+
+        case BATCH_ALLOC: /* mm_malloc_batch */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            if (backend->malloc_batch(size, trace->ops[i].count,
+                                      (void **)&trace->blocks[index])
+                != (size_t)trace->ops[i].count)
+                app_error("mm_malloc_batch error in eval_mm_speed");
+            break;
+
+        case BATCH_FREE: /* mm_free_batch */
+            index = trace->ops[i].index;
+            backend->free_batch((void **)&trace->blocks[index],
+                                trace->ops[i].count);
             break;
 
         default:
@@ -1122,98 +1215,241 @@ static void eval_mm_speed(void *ptr)
 }
 
 /*
- * eval_libc_valid - We run this function to make sure that the
- *    libc malloc can run to completion on the set of traces.
- *    We'll be conservative and terminate if any libc malloc call fails.
- *
+ * touch_block - Read one byte per cache line of a payload
  */
-static int eval_libc_valid(trace_t *trace)
-{
-    int i, newsize;
-    char *p, *newp, *oldp;
+static volatile char touch_sink;
 
-    reinit_trace(trace);
-
-    for (i = 0;  i < trace->num_ops;  i++) {
-        switch (trace->ops[i].type) {
-
-        case ALLOC: /* malloc */
-            if ((p = malloc(trace->ops[i].size)) == NULL) {
-                malloc_error(trace, i, "libc malloc failed");
-                unix_error("System message");
-            }
-            trace->blocks[trace->ops[i].index] = p;
-            break;
+static void touch_block(const char *p, size_t size)
+{
+    char x = 0;
+    size_t off;
 
-        case REALLOC: /* realloc */
-            newsize = trace->ops[i].size;
-            oldp = trace->blocks[trace->ops[i].index];
-            if ((newp = realloc(oldp, newsize)) == NULL && newsize != 0) {
-                malloc_error(trace, i, "libc realloc failed");
-                unix_error("System message");
-            }
-            trace->blocks[trace->ops[i].index] = newp;
-            break;
+    for (off = 0; off < size; off += CACHE_LINE)
+        x ^= ((volatile const char *)p)[off];
+    touch_sink = x;
+}
 
-        case FREE: /* free */
-            if(trace->ops[i].index >= 0) {
-                free(trace->blocks[trace->ops[i].index]);
-            } else {
-                free(0);
-            }
-            break;
+/*
+ * The live blocks of a locality replay: a dense array for random picks
+ * and a doubly linked list, in allocation order, for ordered walks.
+ */
+typedef struct {
+    int *live;        /* live block indices, in no particular order */
+    int *pos;         /* position of each index in live[] */
+    int *next, *prev; /* allocation-order list */
+    int head, tail;
+    int n;            /* number of live blocks */
+} liveset_t;
+
+static void live_add(liveset_t *ls, int index)
+{
+    ls->pos[index] = ls->n;
+    ls->live[ls->n++] = index;
+    ls->prev[index] = ls->tail;
+    ls->next[index] = -1;
+    if (ls->tail >= 0)
+        ls->next[ls->tail] = index;
+    else
+        ls->head = index;
+    ls->tail = index;
+}
 
-        default:
-            app_error("invalid operation type  in eval_libc_valid");
-        }
-    }
+static void live_remove(liveset_t *ls, int index)
+{
+    int j = ls->pos[index];
 
-    return 1;
+    ls->live[j] = ls->live[--ls->n];
+    ls->pos[ls->live[j]] = j;
+    if (ls->prev[index] >= 0)
+        ls->next[ls->prev[index]] = ls->next[index];
+    else
+        ls->head = ls->next[index];
+    if (ls->next[index] >= 0)
+        ls->prev[ls->next[index]] = ls->prev[index];
+    else
+        ls->tail = ls->prev[index];
 }
 
 /*
- * eval_libc_speed - This is the function that is used by fcyc() to
- *    measure the running time of the libc malloc package on the set
- *    of traces.
+ * locality_replay - One pass of the locality mode. Every new payload is
+ *    written as the application would, and every TOUCH_PERIOD ops a
+ *    touch_frac share of the live blocks is read, either walking them in
+ *    allocation order or picking them at random. Cycles and cache misses
+ *    are charged to the allocator or to the application separately.
  */
-static void eval_libc_speed(void *ptr)
+static void locality_replay(trace_t *trace, int order, double *alloc_cyc,
+                            double *alloc_miss, double *app_cyc,
+                            double *app_miss)
 {
-    int i;
-    int index, size, newsize;
-    char *p, *newp, *oldp, *block;
-    trace_t *trace = ((speed_t *)ptr)->trace;
+    int i, j, k, index;
+    size_t size, oldsize;
+    char *p, *oldp;
+    double acc, miss, cyc, cyc_ovhd;
+    unsigned seed = 1;
+    int n = trace->num_ids;
+    liveset_t ls;
+
+    ls.live = malloc(n * sizeof(int));
+    ls.pos = malloc(n * sizeof(int));
+    ls.next = malloc(n * sizeof(int));
+    ls.prev = malloc(n * sizeof(int));
+    if (!ls.live || !ls.pos || !ls.next || !ls.prev)
+        unix_error("malloc failed in locality_replay");
+    ls.head = ls.tail = -1;
+    ls.n = 0;
+
+    *alloc_cyc = *alloc_miss = *app_cyc = *app_miss = 0;
+    cyc_ovhd = ovhd();
 
     reinit_trace(trace);
+    mem_reset_brk();
+    if (backend->init() < 0)
+        app_error("mm_init failed in locality_replay");
+
+/* Charge the cycles and misses of stmt to *cycp and *missp */
+#define CHARGE(cycp, missp, stmt) do {                          \
+        miss = perfctr_read();                                  \
+        start_counter();                                        \
+        stmt;                                                   \
+        cyc = get_counter() - cyc_ovhd;                         \
+        *(cycp) += (cyc > 0) ? cyc : 0;                         \
+        *(missp) += perfctr_read() - miss;                      \
+    } while (0)
 
     for (i = 0;  i < trace->num_ops;  i++) {
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+
         switch (trace->ops[i].type) {
-        case ALLOC: /* malloc */
-            index = trace->ops[i].index;
-            size = trace->ops[i].size;
-            if ((p = malloc(size)) == NULL)
-                unix_error("malloc failed in eval_libc_speed");
+
+        case ALLOC:
+        case MEMALIGN:
+            if (trace->ops[i].type == MEMALIGN)
+                CHARGE(alloc_cyc, alloc_miss,
+                       p = backend->memalign(trace->ops[i].align, size));
+            else
+                CHARGE(alloc_cyc, alloc_miss, p = backend->malloc(size));
+            if (p == NULL)
+                app_error("mm_malloc error in locality_replay");
+            CHARGE(app_cyc, app_miss, memset(p, index, size));
             trace->blocks[index] = p;
+            trace->block_sizes[index] = size;
+            live_add(&ls, index);
             break;
 
-        case REALLOC: /* realloc */
-            index = trace->ops[i].index;
-            newsize = trace->ops[i].size;
+        case REALLOC:
             oldp = trace->blocks[index];
-            if ((newp = realloc(oldp, newsize)) == NULL && newsize != 0)
-                unix_error("realloc failed in eval_libc_speed\n");
+            oldsize = oldp ? trace->block_sizes[index] : 0;
+            CHARGE(alloc_cyc, alloc_miss, p = backend->realloc(oldp, size));
+            if (p == NULL && size != 0)
+                app_error("mm_realloc error in locality_replay");
+            if (size > oldsize)
+                CHARGE(app_cyc, app_miss,
+                       memset(p + oldsize, index, size - oldsize));
+            trace->blocks[index] = p;
+            trace->block_sizes[index] = size;
+            if (oldp == NULL && p != NULL)
+                live_add(&ls, index);
+            else if (oldp != NULL && p == NULL)
+                live_remove(&ls, index);
+            break;
 
-            trace->blocks[index] = newp;
+        case FREE:
+            if (index < 0) {
+                CHARGE(alloc_cyc, alloc_miss, backend->free(NULL));
+                break;
+            }
+            if (trace->blocks[index] != NULL)
+                live_remove(&ls, index);
+            CHARGE(alloc_cyc, alloc_miss, backend->free(trace->blocks[index]));
+            trace->blocks[index] = NULL;
             break;
 
-        case FREE: /* free */
-            index = trace->ops[i].index;
-            if(index >= 0) {
-                block = trace->blocks[index];
-                free(block);
-            } else {
-                free(0);
+        case FREE_SIZED:
+            if (trace->blocks[index] != NULL)
+                live_remove(&ls, index);
+            CHARGE(alloc_cyc, alloc_miss,
+                   backend->free_sized(trace->blocks[index], size));
+            trace->blocks[index] = NULL;
+            break;
+
+        case BATCH_ALLOC:
+            CHARGE(alloc_cyc, alloc_miss,
+                   j = backend->malloc_batch(size, trace->ops[i].count,
+                                             (void **)&trace->blocks[index]));
+            if (j != trace->ops[i].count)
+                app_error("mm_malloc_batch error in locality_replay");
+            for (k = index; k < index + j; k++) {
+                CHARGE(app_cyc, app_miss, memset(trace->blocks[k], k, size));
+                trace->block_sizes[k] = size;
+                live_add(&ls, k);
             }
             break;
+
+        case BATCH_FREE:
+            for (k = index; k < index + trace->ops[i].count; k++)
+                if (trace->blocks[k] != NULL)
+                    live_remove(&ls, k);
+            CHARGE(alloc_cyc, alloc_miss,
+                   backend->free_batch((void **)&trace->blocks[index],
+                                       trace->ops[i].count));
+            for (k = index; k < index + trace->ops[i].count; k++)
+                trace->blocks[k] = NULL;
+            break;
+
+        default:
+            app_error("Nonexistent request type in locality_replay");
+        }
+
+        if ((i + 1) % TOUCH_PERIOD || ls.n == 0)
+            continue;
+
+        /* The application reads back part of its live data */
+        if (order == ORDER_ALLOC) {
+            acc = 0;
+            CHARGE(app_cyc, app_miss,
+                   for (j = ls.head; j >= 0; j = ls.next[j]) {
+                       acc += touch_frac;
+                       if (acc >= 1) {
+                           acc -= 1;
+                           touch_block(trace->blocks[j],
+                                       trace->block_sizes[j]);
+                       }
+                   });
+        } else {
+            CHARGE(app_cyc, app_miss,
+                   for (k = (int)(ls.n * touch_frac + 0.5); k > 0; k--) {
+                       j = ls.live[rand_r(&seed) % ls.n];
+                       touch_block(trace->blocks[j], trace->block_sizes[j]);
+                   });
+        }
+    }
+#undef CHARGE
+
+    free(ls.live);
+    free(ls.pos);
+    free(ls.next);
+    free(ls.prev);
+}
+
+/*
+ * eval_mm_locality - Replay the trace in locality mode, once per sweep
+ *    order, and record where the cycles and misses went
+ */
+static void eval_mm_locality(trace_t *trace, stats_t *stats)
+{
+    double alloc_cyc, alloc_miss;
+    int have_misses = (perfctr_open() == 0);
+    int order;
+
+    for (order = ORDER_ALLOC; order <= ORDER_RANDOM; order++) {
+        locality_replay(trace, order, &alloc_cyc, &alloc_miss,
+                        &stats->app_cyc[order], &stats->app_miss[order]);
+        if (!have_misses)
+            stats->app_miss[order] = -1;
+        if (order == ORDER_ALLOC) {
+            stats->alloc_cyc = alloc_cyc;
+            stats->alloc_miss = have_misses ? alloc_miss : -1;
         }
     }
 }
@@ -1226,7 +1462,7 @@ static void eval_libc_speed(void *ptr)
 /*
  * printresults - prints a performance summary for some malloc package
  */
-static void printresults(int n, stats_t *stats)
+static void printresults(int n, stats_t *stats, int nerrors)
 {
     int i;
     /* weighted sums all */
@@ -1239,8 +1475,8 @@ static void printresults(int n, stats_t *stats)
     char wstr;
 
     /* Print the individual results for each trace */
-    printf("  %2s%6s %5s%8s%9s  %s\n",
-           "valid", "util", "ops", "secs", "Kops", "trace");
+    printf("  %2s%6s %5s%8s%9s%6s%7s  %s\n",
+           "valid", "util", "ops", "secs", "Kops", "sd%", "faults", "trace");
     for (i=0; i < n; i++) {
         if (stats[i].valid) {
             switch(stats[i].weight)
@@ -1277,11 +1513,13 @@ static void printresults(int n, stats_t *stats)
             /* print '--' if perf isn't weighted */
             if(stats[i].weight == WNONE || stats[i].weight == WALL
                || stats[i].weight == WPERF)
-                printf("%8.0f%10.6f%6.0f", stats[i].ops, stats[i].secs,
-                       (stats[i].ops/1e3)/stats[i].secs);
+                printf("%8.0f%10.6f%6.0f%6.1f", stats[i].ops, stats[i].secs,
+                       (stats[i].ops/1e3)/stats[i].secs,
+                       100.0*stats[i].sdev/stats[i].secs);
             else
-                printf("%8s%10s%6s", "--", "--", "--");
+                printf("%8s%10s%6s%6s", "--", "--", "--", "--");
 
+            printf("%7ld", stats[i].faults);
             printf(" %s\n", stats[i].filename);
 
             if(stats[i].weight == WALL || stats[i].weight == WPERF)
@@ -1297,19 +1535,21 @@ static void printresults(int n, stats_t *stats)
                 }
         }
         else {
-            printf("%2s%4s %6s%8s%10s%6s %s\n",
+            printf("%2s%4s %6s%8s%10s%6s%6s%7s %s\n",
                    stats[i].weight != 0 ? "*" : "",
                    "no",
                    "-",
                    "-",
                    "-",
                    "-",
+                   "-",
+                   "-",
                    stats[i].filename);
         }
     }
 
     /* Print the aggregate results for the set of traces */
-    if (errors == 0) {
+    if (nerrors == 0) {
         if(sum_perf_weight == 0) sum_perf_weight = 1;
         if(sum_util_weight == 0) sum_util_weight = 1;
 
@@ -1330,6 +1570,125 @@ static void printresults(int n, stats_t *stats)
 
 }
 
+/*
+ * printlocality - prints where the cycles and cache misses went in
+ *     locality mode (thousands of cycles, thousands of misses)
+ */
+static void printlocality(int n, stats_t *stats)
+{
+    int i, order;
+
+    printf("Locality (reading %.0f%% of live blocks every %d ops):\n",
+           touch_frac * 100.0, TOUCH_PERIOD);
+    printf("%-24s%18s%18s%18s\n", "", "malloc/free",
+           "app, alloc order", "app, random");
+    printf("%-24s", "trace");
+    for (i = 0; i < 3; i++)
+        printf("%9s%9s", "Kcyc", "Kmiss");
+    printf("\n");
+
+    for (i = 0; i < n; i++) {
+        const char *name = strrchr(stats[i].filename, '/');
+
+        printf("%-24s", name ? name + 1 : stats[i].filename);
+        if (!stats[i].valid) {
+            printf("%18s\n", "invalid");
+            continue;
+        }
+        printf("%9.0f", stats[i].alloc_cyc / 1e3);
+        if (stats[i].alloc_miss < 0)
+            printf("%9s", "--");
+        else
+            printf("%9.1f", stats[i].alloc_miss / 1e3);
+        for (order = ORDER_ALLOC; order <= ORDER_RANDOM; order++) {
+            printf("%9.0f", stats[i].app_cyc[order] / 1e3);
+            if (stats[i].app_miss[order] < 0)
+                printf("%9s", "--");
+            else
+                printf("%9.1f", stats[i].app_miss[order] / 1e3);
+        }
+        printf("\n");
+    }
+}
+
+/*
+ * printcomparison - prints every backend side by side, trace by trace
+ */
+static void printcomparison(int n, int nbackends,
+                            const mm_backend_t **backends, stats_t **stats)
+{
+    int i, b;
+
+    printf("Comparison (util / Kops):\n");
+    printf("%-24s", "trace");
+    for (b = 0; b < nbackends; b++)
+        printf("%16s", backends[b]->name);
+    printf("\n");
+
+    for (i = 0; i < n; i++) {
+        const char *name = strrchr(stats[0][i].filename, '/');
+
+        printf("%-24s", name ? name + 1 : stats[0][i].filename);
+        for (b = 0; b < nbackends; b++) {
+            stats_t *st = &stats[b][i];
+
+            if (!st->valid)
+                printf("%16s", "invalid");
+            else if (!backends[b]->uses_memlib)
+                printf("%8s%8.0f", "--", (st->ops/1e3)/st->secs);
+            else
+                printf("%7.0f%%%8.0f", st->util * 100.0,
+                       (st->ops/1e3)/st->secs);
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+/*
+ * has_backend - Is the backend called name already in the list?
+ */
+static int has_backend(const mm_backend_t **backends, int n, const char *name)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        if (strcmp(backends[i]->name, name) == 0)
+            return 1;
+    return 0;
+}
+
+/*
+ * add_backends - Append the backends named in a comma-separated list
+ *     (or all of them, for "all") and return the new count
+ */
+static int add_backends(const mm_backend_t **backends, int n,
+                        const char *list)
+{
+    char buf[MAXLINE];
+    char *name;
+    const mm_backend_t *b;
+
+    if (strcmp(list, "all") == 0) {
+        for (b = mm_backends; b->name != NULL; b++)
+            n = add_backends(backends, n, b->name);
+        return n;
+    }
+
+    strncpy(buf, list, MAXLINE - 1);
+    buf[MAXLINE - 1] = '\0';
+    for (name = strtok(buf, ","); name != NULL; name = strtok(NULL, ",")) {
+        if ((b = find_backend(name)) == NULL)
+            app_error("Unknown backend \"%s\"; try -h\n", name);
+        if (has_backend(backends, n, name))
+            continue;
+        if (n == MAXBACKENDS)
+            app_error("Too many backends (at most %d)\n", MAXBACKENDS);
+        backends[n++] = b;
+    }
+    return n;
+}
+
 /*
  * app_error - Report an arbitrary application error
  */
@@ -1370,21 +1729,48 @@ void malloc_error(const trace_t *trace, int opnum, const char *fmt, ...)
     va_end(ap);
 }
 
+/*
+ * page_faults - Page faults the driver has taken so far, not counting
+ *     those memlib took ahead of time to prefault the heap
+ */
+static long page_faults(void)
+{
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru) < 0)
+        unix_error("getrusage failed in page_faults");
+    return ru.ru_minflt + ru.ru_majflt - mem_prefault_faults();
+}
+
 /*
  * usage - Explain the command line arguments
  */
 static void usage(void)
 {
-    fprintf(stderr, "Usage: mdriver [-hlVdD] [-f <file>]\n");
+    const mm_backend_t *b;
+
+    fprintf(stderr, "Usage: mdriver [-hlVdD] [-b <list>] [-f <file>]\n");
     fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-b <list>  Evaluate these backends (comma-separated, or all).\n");
     fprintf(stderr, "\t-d <i>     Debug: 0 off; 1 default; 2 lots.\n");
     fprintf(stderr, "\t-D         Equivalent to -d2.\n");
     fprintf(stderr, "\t-c <file>  Run trace file <file> once, check for correctness only.\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
+    fprintf(stderr, "\t-F <f>     Prefault the heap ahead of the brk: none (default),\n"
+                    "\t           populate, touch or lock.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
-    fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-H <mb>    Let each heap grow to <mb> MB (default %zu).\n",
+            (size_t)MAX_HEAP >> 20);
+    fprintf(stderr, "\t-l         Run libc malloc as well (same as adding -b libc).\n");
+    fprintf(stderr, "\t-L <f>     Also replay touching payloads, reading fraction <f>\n"
+                    "\t           of the live blocks every %d ops.\n", TOUCH_PERIOD);
+    fprintf(stderr, "\t-P <p>     Back the heap with small (default), thp (transparent\n"
+                    "\t           huge) or hugetlb (hugetlbfs pool) pages.\n");
     fprintf(stderr, "\t-V         Print diagnostics as each trace is run.\n");
     fprintf(stderr, "\t-v <i>     Set Verbosity Level to <i>\n");
     fprintf(stderr, "\t-s <s>     Timeout after s secs (default no timeout)\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
+    fprintf(stderr, "Backends\n");
+    for (b = mm_backends; b->name != NULL; b++)
+        fprintf(stderr, "\t%-10s %s\n", b->name, b->descr);
 }
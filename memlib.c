@@ -2,12 +2,38 @@
  * memlib.c - a module that simulates the memory system.	Needed because it 
  *						allows us to interleave calls from the student's malloc package 
  *						with the system's malloc package in libc.
+ *
+ * The heap is reserved once as MAX_HEAP bytes (or what mem_set_max_heap
+ * asked for) of inaccessible address space. As the brk grows past the
+ * committed part, the next COMMIT_SIZE bytes are made writable in one
+ * mprotect, so most mem_sbrk calls are just a pointer bump.
+ *
+ * mem_create reserves more heaps the same way, each with its own brk,
+ * mem_select picks the one the other calls work on, and mem_destroy
+ * unmaps one whole, so its pages leave the process at once.
+ *
+ * With mem_set_pages the heap can be backed by huge pages instead:
+ *  MEM_PAGES_THP      transparent huge pages (madvise MADV_HUGEPAGE)
+ *  MEM_PAGES_HUGETLB  pages from the hugetlbfs pool (MAP_HUGETLB)
+ * Either way the heap starts on a huge page boundary and is committed
+ * in whole huge pages. When the pool is empty it falls back to
+ * transparent huge pages, and when those are off to ordinary pages,
+ * without a word.
+ *
+ * With mem_set_prefault the heap is kept a commit step ahead of the brk,
+ * and each step is faulted in as it is committed, so the allocations
+ * that grow the heap, and the writes to new blocks, take no page faults:
+ *  MEM_PREFAULT_POPULATE  madvise MADV_POPULATE_WRITE (touch if too old)
+ *  MEM_PREFAULT_TOUCH     write a byte to each page
+ *  MEM_PREFAULT_LOCK      mlock, which also keeps the pages resident
+ *                         (populate if RLIMIT_MEMLOCK is too low)
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -16,38 +42,236 @@
 #include "memlib.h"
 #include "config.h"
 
+/* One heap: the region of mem_init, or one of mem_create */
+struct mem {
+	char *heap;
+	char *mem_brk;
+	char *mem_commit_brk;	/* end of the writable part of the heap */
+	char *mem_zero_brk;		/* the heap above has never been handed out */
+	char *mem_max_addr;
+	int heap_pages;			/* what the heap actually got */
+	size_t commit_size;		/* commit step of the heap */
+	char *mem_map;			/* the reservation, heap is aligned in it */
+	size_t mem_map_len;
+};
+
 /* private variables */
-static char *heap;
-static char *mem_brk;
-static char *mem_max_addr;
+static mem_t main_mem;				/* the heap of mem_init */
+static mem_t *m = &main_mem;		/* the heap the calls below work on */
+static size_t max_heap = MAX_HEAP;	/* size of the next reservation */
+static int pages = MEM_PAGES_SMALL;	/* what the next mem_init asks for */
+static int prefault = MEM_PREFAULT_NONE;
+static long prefault_faults;		/* page faults taken while prefaulting */
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23		/* Linux 5.14; older ones refuse it */
+#endif
+
+/*
+ * mem_huge_probe - return 1 if the hugetlbfs pool can hand out a page
+ */
+static int mem_huge_probe(void) {
+#ifdef MAP_HUGETLB
+	void *p = mmap(NULL, HUGE_PAGE, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (p == MAP_FAILED)
+		return 0;
+	munmap(p, HUGE_PAGE);
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * mem_reserve - reserve the address space of heap r, with start as a
+ *		hint of where; returns -1 if the kernel refuses
+ */
+static int mem_reserve(mem_t *r, void *start) {
+	size_t len = max_heap;
+
+	r->heap_pages = pages;
+	if (r->heap_pages == MEM_PAGES_HUGETLB && !mem_huge_probe())
+		r->heap_pages = MEM_PAGES_THP;
+	r->commit_size = COMMIT_SIZE;
+	if (r->heap_pages != MEM_PAGES_SMALL) {
+		r->commit_size = (COMMIT_SIZE + HUGE_PAGE - 1) & ~(size_t)(HUGE_PAGE - 1);
+		len = (len + HUGE_PAGE - 1) & ~(size_t)(HUGE_PAGE - 1);
+	}
+	/* leave room to align the heap to a huge page */
+	r->mem_map_len = len + (r->heap_pages != MEM_PAGES_SMALL ? HUGE_PAGE : 0);
+	r->mem_map = mmap(start,				/* suggested start*/
+			r->mem_map_len,			/* length */
+			PROT_NONE,				/* reserved, see mem_commit */
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+			-1,						/* fd */
+			0);						/* offset */
+	if (r->mem_map == MAP_FAILED)
+		return -1;
+	r->heap = r->mem_map;
+	if (r->heap_pages != MEM_PAGES_SMALL)
+		r->heap = (char *)(((size_t)r->mem_map + HUGE_PAGE - 1) & ~(size_t)(HUGE_PAGE - 1));
+#ifdef MADV_HUGEPAGE
+	if (r->heap_pages == MEM_PAGES_THP && madvise(r->heap, len, MADV_HUGEPAGE) < 0)
+		r->heap_pages = MEM_PAGES_SMALL;
+#else
+	if (r->heap_pages == MEM_PAGES_THP)
+		r->heap_pages = MEM_PAGES_SMALL;
+#endif
+	r->mem_max_addr = r->heap + len;
+	r->mem_brk = r->heap;				/* heap is empty initially */
+	r->mem_commit_brk = r->heap;		/* and none of it is writable */
+	r->mem_zero_brk = r->heap;			/* or dirty */
+	return 0;
+}
 
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(void){
-	int dev_zero = open("/dev/zero", O_RDWR);
-	heap = mmap((void *)0x800000000, /* suggested start*/
-			MAX_HEAP,				/* length */
-			PROT_WRITE,				/* permissions */
-			MAP_PRIVATE,			/* private or shared? */
-			dev_zero,				/* fd */
-			0);						/* offset (dunno) */
-	mem_max_addr = heap + MAX_HEAP;
-	mem_brk = heap;					/* heap is empty initially */
+	m = &main_mem;
+	if (mem_reserve(m, (void *)0x800000000) < 0) {
+		fprintf(stderr, "ERROR: mem_init failed to reserve the heap: %s\n",
+				strerror(errno));
+		exit(1);
+	}
 }
 
 /* 
  * mem_deinit - free the storage used by the memory system model
  */
 void mem_deinit(void){
-	munmap(heap, MAX_HEAP);
+	munmap(main_mem.mem_map, main_mem.mem_map_len);
+}
+
+/*
+ * mem_create - reserve another heap, as mem_init did the first one;
+ *		returns NULL if there is no room for it. The calls below keep
+ *		working on the heap they did until mem_select says otherwise.
+ */
+mem_t *mem_create(void) {
+	mem_t *r;
+
+	if ((r = malloc(sizeof(mem_t))) == NULL)
+		return NULL;
+	if (mem_reserve(r, NULL) < 0) {
+		free(r);
+		return NULL;
+	}
+	return r;
+}
+
+/*
+ * mem_destroy - give a heap of mem_create back, all of it in one munmap
+ */
+void mem_destroy(mem_t *r) {
+	if (m == r)
+		m = &main_mem;
+	munmap(r->mem_map, r->mem_map_len);
+	free(r);
+}
+
+/*
+ * mem_select - make r the heap that mem_sbrk and the calls below work on,
+ *		or the heap of mem_init if r is NULL; returns the one that was
+ *		(NULL for that of mem_init)
+ */
+mem_t *mem_select(mem_t *r) {
+	mem_t *was = (m == &main_mem) ? NULL : m;
+
+	m = r ? r : &main_mem;
+	return was;
 }
 
 /*
  * mem_reset_brk - reset the simulated brk pointer to make an empty heap
+ *		(what is committed stays committed, and dirty)
  */
 void mem_reset_brk(){
-	mem_brk = heap;
+	if (m->mem_brk > m->mem_zero_brk)
+		m->mem_zero_brk = m->mem_brk;
+	m->mem_brk = m->heap;
+}
+
+/*
+ * mem_faults - page faults the process has taken so far
+ */
+static long mem_faults(void) {
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_minflt + ru.ru_majflt;
+}
+
+/*
+ * mem_prefault - fault in len newly committed bytes at lo
+ */
+static void mem_prefault(char *lo, size_t len) {
+	long faults = mem_faults();
+	size_t pagesize = mem_pagesize();
+	char *p;
+
+	switch (prefault) {
+	case MEM_PREFAULT_LOCK:
+		if (mlock(lo, len) == 0)
+			break;
+		/* fall through */
+	case MEM_PREFAULT_POPULATE:
+		if (madvise(lo, len, MADV_POPULATE_WRITE) == 0)
+			break;
+		/* fall through */
+	case MEM_PREFAULT_TOUCH:
+		/* the pages are new, so they hold zeros */
+		for (p = lo; p < lo + len; p += pagesize)
+			*(volatile char *)p = 0;
+		break;
+	}
+	prefault_faults += mem_faults() - faults;
+}
+
+/*
+ * mem_commit - make the heap writable up to at least offset need, rounded
+ *		up to the commit step. Returns -1 if the kernel refuses.
+ */
+static int mem_commit(size_t need) {
+	char *new_commit = m->heap + (need + m->commit_size - 1) / m->commit_size * m->commit_size;
+
+	if (new_commit > m->mem_max_addr)
+		new_commit = m->mem_max_addr;
+	if (new_commit <= m->mem_commit_brk)
+		return 0;
+#ifdef MAP_HUGETLB
+	/* Map pool pages over the reservation; if the pool has run dry,
+	   the rest of the heap gets transparent huge pages */
+	if (m->heap_pages == MEM_PAGES_HUGETLB) {
+		if (mmap(m->mem_commit_brk, new_commit - m->mem_commit_brk,
+				PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB,
+				-1, 0) != MAP_FAILED)
+			goto committed;
+		/* a failed MAP_FIXED may have unmapped the range: reserve it again */
+		if (mmap(m->mem_commit_brk, m->mem_max_addr - m->mem_commit_brk, PROT_NONE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+				-1, 0) == MAP_FAILED)
+			return -1;
+		m->heap_pages = MEM_PAGES_THP;
+#ifdef MADV_HUGEPAGE
+		if (madvise(m->mem_commit_brk, m->mem_max_addr - m->mem_commit_brk,
+				MADV_HUGEPAGE) < 0)
+			m->heap_pages = MEM_PAGES_SMALL;
+#endif
+	}
+#endif
+	if (mprotect(m->mem_commit_brk, new_commit - m->mem_commit_brk,
+			PROT_READ | PROT_WRITE) < 0)
+		return -1;
+#ifdef MAP_HUGETLB
+committed:
+#endif
+	if (prefault != MEM_PREFAULT_NONE)
+		mem_prefault(m->mem_commit_brk, new_commit - m->mem_commit_brk);
+	m->mem_commit_brk = new_commit;
+	return 0;
 }
 
 /* 
@@ -55,18 +279,20 @@ void mem_reset_brk(){
  *		by incr bytes and returns the start address of the new area. In
  *		this model, the heap cannot be shrunk.
  */
-void *mem_sbrk(int incr) {
-	char *old_brk = mem_brk;
+void *mem_sbrk(size_t incr) {
+	char *old_brk = m->mem_brk;
+	/* when prefaulting, stay a step ahead */
+	size_t need = (m->mem_brk - m->heap) + incr +
+		(prefault != MEM_PREFAULT_NONE ? m->commit_size : 0);
 
-    // call sbrk() in an attempt to have similar semantics as a real allocator.
-	if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr) ||
-            sbrk(incr) == (void *) -1) {
+	if ( (incr > (size_t)(m->mem_max_addr - m->mem_brk)) ||
+            (need > (size_t)(m->mem_commit_brk - m->heap) && mem_commit(need) < 0)) {
 		errno = ENOMEM;
 		fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 		return (void *)-1;
 	}
 
-	mem_brk += incr;
+	m->mem_brk += incr;
 	return (void *)old_brk;
 }
 
@@ -74,21 +300,29 @@ void *mem_sbrk(int incr) {
  * mem_heap_lo - return address of the first heap byte
  */
 void *mem_heap_lo(){
-	return (void *)heap;
+	return (void *)m->heap;
 }
 
 /* 
  * mem_heap_hi - return address of last heap byte
  */
 void *mem_heap_hi(){
-	return (void *)(mem_brk - 1);
+	return (void *)(m->mem_brk - 1);
 }
 
 /*
  * mem_heapsize() - returns the heap size in bytes
  */
 size_t mem_heapsize() {
-	return (size_t)((void *)mem_brk - (void *)heap);
+	return (size_t)((void *)m->mem_brk - (void *)m->heap);
+}
+
+/*
+ * mem_zero_lo - returns the address from which the heap has never been
+ *		handed out by mem_sbrk, so mem_sbrk hands out zeros from there on
+ */
+void *mem_zero_lo() {
+	return (void *)(m->mem_brk > m->mem_zero_brk ? m->mem_brk : m->mem_zero_brk);
 }
 
 /*
@@ -97,3 +331,50 @@ size_t mem_heapsize() {
 size_t mem_pagesize(){
 	return (size_t)getpagesize();
 }
+
+/*
+ * mem_set_max_heap - set the size of the heap reserved by the next
+ *		mem_init, rounded up to COMMIT_SIZE
+ */
+void mem_set_max_heap(size_t bytes) {
+	max_heap = (bytes + COMMIT_SIZE - 1) / COMMIT_SIZE * COMMIT_SIZE;
+}
+
+/*
+ * mem_set_pages - set the pages that back the heap from the next
+ *		mem_init on: MEM_PAGES_SMALL, MEM_PAGES_THP or MEM_PAGES_HUGETLB
+ */
+void mem_set_pages(int mode) {
+	pages = mode;
+}
+
+/*
+ * mem_set_prefault - set how the heap is prefaulted from now on:
+ *		MEM_PREFAULT_NONE, _POPULATE, _TOUCH or _LOCK
+ */
+void mem_set_prefault(int mode) {
+	prefault = mode;
+}
+
+/*
+ * mem_prefault_faults - returns the page faults taken while prefaulting,
+ *		which happen ahead of the brk rather than on the heap's users
+ */
+long mem_prefault_faults() {
+	return prefault_faults;
+}
+
+/*
+ * mem_huge_pagesize - returns the huge page size if the heap is backed by
+ *		huge pages, else 0
+ */
+size_t mem_huge_pagesize() {
+	return m->heap_pages != MEM_PAGES_SMALL ? HUGE_PAGE : 0;
+}
+
+/*
+ * mem_max_heap - returns the most the heap can grow to
+ */
+size_t mem_max_heap() {
+	return (size_t)(m->mem_max_addr - m->heap);
+}
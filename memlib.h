@@ -1,11 +1,35 @@
 #include <unistd.h>
 
+/* What backs the heap, see mem_set_pages */
+#define MEM_PAGES_SMALL   0
+#define MEM_PAGES_THP     1
+#define MEM_PAGES_HUGETLB 2
+
+/* How the heap is faulted in ahead of the brk, see mem_set_prefault */
+#define MEM_PREFAULT_NONE     0
+#define MEM_PREFAULT_POPULATE 1
+#define MEM_PREFAULT_TOUCH    2
+#define MEM_PREFAULT_LOCK     3
+
+/* A heap of its own, see mem_create */
+typedef struct mem mem_t;
+
 void mem_init(void);               
 void mem_deinit(void);
-void *mem_sbrk(int incr);
+mem_t *mem_create(void);
+void mem_destroy(mem_t *r);
+mem_t *mem_select(mem_t *r);
+void *mem_sbrk(size_t incr);
 void mem_reset_brk(void); 
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
 size_t mem_heapsize(void);
+void *mem_zero_lo(void);
 size_t mem_pagesize(void);
+void mem_set_max_heap(size_t bytes);
+size_t mem_max_heap(void);
+void mem_set_pages(int mode);
+size_t mem_huge_pagesize(void);
+void mem_set_prefault(int mode);
+long mem_prefault_faults(void);
 
@@ -0,0 +1,208 @@
+/*
+ * memops.c - Bulk copy and zero for large blocks
+ *
+ * memcpy and memset write through the cache, so copying or clearing a
+ * few megabytes evicts the working set of the program for data it will
+ * not read again soon. Non-temporal (streaming) stores go to memory
+ * instead. The engine is picked on first use: AVX2 stores 32 bytes at a
+ * time, SSE2 16; elsewhere memops falls back to memcpy and memset.
+ * Streaming stores need an aligned destination, so the first bytes up
+ * to the alignment and the tail are copied the ordinary way.
+ */
+#include <stdint.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MEMOPS_X86
+#endif
+
+#include "memops.h"
+
+typedef void (*copy_fn_t)(void *dst, const void *src, size_t n);
+typedef void (*zero_fn_t)(void *dst, size_t n);
+
+static copy_fn_t copy_nt;
+static zero_fn_t zero_nt;
+static const char *engine;
+
+static void copy_plain(void *dst, const void *src, size_t n)
+{
+    memcpy(dst, src, n);
+}
+
+static void zero_plain(void *dst, size_t n)
+{
+    memset(dst, 0, n);
+}
+
+#ifdef MEMOPS_X86
+__attribute__((target("avx2")))
+static void copy_avx2(void *dst, const void *src, size_t n)
+{
+    char *d = dst;
+    const char *s = src;
+    size_t head = -(uintptr_t)d & 31;
+    __m256i a, b, c, e;
+
+    if (n < 2 * 32) {
+        memcpy(d, s, n);
+        return;
+    }
+    memcpy(d, s, head);
+    d += head, s += head, n -= head;
+    for (; n >= 128; d += 128, s += 128, n -= 128) {
+        a = _mm256_loadu_si256((const __m256i *)s);
+        b = _mm256_loadu_si256((const __m256i *)(s + 32));
+        c = _mm256_loadu_si256((const __m256i *)(s + 64));
+        e = _mm256_loadu_si256((const __m256i *)(s + 96));
+        _mm256_stream_si256((__m256i *)d, a);
+        _mm256_stream_si256((__m256i *)(d + 32), b);
+        _mm256_stream_si256((__m256i *)(d + 64), c);
+        _mm256_stream_si256((__m256i *)(d + 96), e);
+    }
+    for (; n >= 32; d += 32, s += 32, n -= 32)
+        _mm256_stream_si256((__m256i *)d,
+                            _mm256_loadu_si256((const __m256i *)s));
+    _mm_sfence();
+    memcpy(d, s, n);
+}
+
+__attribute__((target("avx2")))
+static void zero_avx2(void *dst, size_t n)
+{
+    char *d = dst;
+    size_t head = -(uintptr_t)d & 31;
+    __m256i z = _mm256_setzero_si256();
+
+    if (n < 2 * 32) {
+        memset(d, 0, n);
+        return;
+    }
+    memset(d, 0, head);
+    d += head, n -= head;
+    for (; n >= 128; d += 128, n -= 128) {
+        _mm256_stream_si256((__m256i *)d, z);
+        _mm256_stream_si256((__m256i *)(d + 32), z);
+        _mm256_stream_si256((__m256i *)(d + 64), z);
+        _mm256_stream_si256((__m256i *)(d + 96), z);
+    }
+    for (; n >= 32; d += 32, n -= 32)
+        _mm256_stream_si256((__m256i *)d, z);
+    _mm_sfence();
+    memset(d, 0, n);
+}
+
+__attribute__((target("sse2")))
+static void copy_sse2(void *dst, const void *src, size_t n)
+{
+    char *d = dst;
+    const char *s = src;
+    size_t head = -(uintptr_t)d & 15;
+    __m128i a, b, c, e;
+
+    if (n < 2 * 16) {
+        memcpy(d, s, n);
+        return;
+    }
+    memcpy(d, s, head);
+    d += head, s += head, n -= head;
+    for (; n >= 64; d += 64, s += 64, n -= 64) {
+        a = _mm_loadu_si128((const __m128i *)s);
+        b = _mm_loadu_si128((const __m128i *)(s + 16));
+        c = _mm_loadu_si128((const __m128i *)(s + 32));
+        e = _mm_loadu_si128((const __m128i *)(s + 48));
+        _mm_stream_si128((__m128i *)d, a);
+        _mm_stream_si128((__m128i *)(d + 16), b);
+        _mm_stream_si128((__m128i *)(d + 32), c);
+        _mm_stream_si128((__m128i *)(d + 48), e);
+    }
+    for (; n >= 16; d += 16, s += 16, n -= 16)
+        _mm_stream_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+    _mm_sfence();
+    memcpy(d, s, n);
+}
+
+__attribute__((target("sse2")))
+static void zero_sse2(void *dst, size_t n)
+{
+    char *d = dst;
+    size_t head = -(uintptr_t)d & 15;
+    __m128i z = _mm_setzero_si128();
+
+    if (n < 2 * 16) {
+        memset(d, 0, n);
+        return;
+    }
+    memset(d, 0, head);
+    d += head, n -= head;
+    for (; n >= 64; d += 64, n -= 64) {
+        _mm_stream_si128((__m128i *)d, z);
+        _mm_stream_si128((__m128i *)(d + 16), z);
+        _mm_stream_si128((__m128i *)(d + 32), z);
+        _mm_stream_si128((__m128i *)(d + 48), z);
+    }
+    for (; n >= 16; d += 16, n -= 16)
+        _mm_stream_si128((__m128i *)d, z);
+    _mm_sfence();
+    memset(d, 0, n);
+}
+#endif /* def MEMOPS_X86 */
+
+/*
+ * memops_init - Pick the widest streaming stores the CPU has
+ */
+static void memops_init(void)
+{
+#ifdef MEMOPS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        copy_nt = copy_avx2;
+        zero_nt = zero_avx2;
+        engine = "avx2";
+        return;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        copy_nt = copy_sse2;
+        zero_nt = zero_sse2;
+        engine = "sse2";
+        return;
+    }
+#endif
+    copy_nt = copy_plain;
+    zero_nt = zero_plain;
+    engine = "none";
+}
+
+void memops_copy(void *dst, const void *src, size_t n)
+{
+    if (n < MEMOPS_NT_MIN) {
+        memcpy(dst, src, n);
+        return;
+    }
+    memops_copy_nt(dst, src, n);
+}
+
+void memops_zero(void *dst, size_t n)
+{
+    if (n < MEMOPS_NT_MIN) {
+        memset(dst, 0, n);
+        return;
+    }
+    if (zero_nt == NULL)
+        memops_init();
+    zero_nt(dst, n);
+}
+
+void memops_copy_nt(void *dst, const void *src, size_t n)
+{
+    if (copy_nt == NULL)
+        memops_init();
+    copy_nt(dst, src, n);
+}
+
+const char *memops_engine(void)
+{
+    if (engine == NULL)
+        memops_init();
+    return engine;
+}
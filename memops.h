@@ -0,0 +1,29 @@
+/*
+ * memops.h - Bulk copy and zero that keep large blocks out of the cache
+ *
+ * From MEMOPS_NT_MIN bytes on, memops_copy and memops_zero write with
+ * non-temporal stores, which bypass the cache; below that they are
+ * memcpy and memset. The widest stores the CPU has are picked at run
+ * time.
+ */
+#include <stddef.h>
+
+/* Size from which copies and clears bypass the cache. Streaming is
+   slower than memcpy while the block fits in the last-level cache; what
+   it buys is not evicting everything else, which only matters past it */
+#ifndef MEMOPS_NT_MIN
+#define MEMOPS_NT_MIN (8 << 20)
+#endif
+
+/* memcpy of n bytes; the ranges must not overlap */
+void memops_copy(void *dst, const void *src, size_t n);
+
+/* memset of n bytes to zero */
+void memops_zero(void *dst, size_t n);
+
+/* memops_copy with non-temporal stores whatever n is, for callers that
+   stream one large block in pieces */
+void memops_copy_nt(void *dst, const void *src, size_t n);
+
+/* Stores used for large blocks: "avx2", "sse2" or "none" */
+const char *memops_engine(void);
@@ -0,0 +1,940 @@
+/*
+ * mm-bench.c - Microbenchmarks for the fast paths and internals of mm.c
+ *
+ * Whole-trace replay (mdriver) averages over every size class and every
+ * kind of request, so a regression in one class disappears in the total.
+ * Each benchmark here exercises one thing: malloc/free pairs at a fixed
+ * size, the sizes on either side of every seg list boundary, free order,
+ * searches of long free lists, batches against loops, heaps dropped
+ * whole, regions reset and pools against blocks freed one by one,
+ * realloc growth chains, and extend_heap, coalesce and splice_block on
+ * their own. Every benchmark gets warmup runs and repetitions, and reports
+ * nanoseconds per operation.
+ *
+ * With -c it times nothing, and checks instead that the heap stays
+ * valid and the payloads intact through what the benchmarks only time.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "mm-internals.h"
+#include "memlib.h"
+#include "memops.h"
+#include "clock.h"
+#include "config.h"
+
+/* Defaults, see usage() */
+#define WARMUP     2
+#define REPS       9
+#define NBLOCKS    4096   /* live blocks in the free-order benchmarks */
+#define NPAIRS     100000 /* malloc/free pairs per run */
+#define NEXTEND    2048   /* heap extensions per run */
+#define EXTEND_WORDS (672/4)
+#define NBULK      16     /* copies or clears per run */
+#define NBATCH     256    /* blocks per malloc_batch/free_batch */
+#define MAXBENCH   256
+#define NHEAPS     4      /* heaps of their own in the checks */
+#define CHECK_ROUNDS 8
+
+/* One benchmark: setup runs untimed before every timed run */
+typedef struct {
+    char name[64];
+    void (*setup)(long arg);
+    long (*run)(long arg);  /* returns the number of operations done */
+    long arg;
+} bench_t;
+
+static bench_t benches[MAXBENCH];
+static int nbenches = 0;
+
+static int warmup = WARMUP;
+static int reps = REPS;
+static double Mhz;
+
+/* Blocks handed from setup to run, and back */
+static void *blocks[NBLOCKS];
+static int order[NBLOCKS];
+
+static void app_error(const char *msg)
+{
+    fprintf(stderr, "%s\n", msg);
+    exit(1);
+}
+
+/*
+ * fresh_heap - Start over with an empty heap
+ */
+static void fresh_heap(long arg __attribute__((unused)))
+{
+    mem_reset_brk();
+    if (mm_init() < 0)
+        app_error("mm_init failed");
+}
+
+/*****************************************************
+ * Benchmarks through the public interface
+ *****************************************************/
+
+/* malloc immediately followed by free, arg bytes */
+static long run_pairs(long arg)
+{
+    long i;
+    void *p;
+
+    for (i = 0; i < NPAIRS; i++) {
+        if ((p = mm_malloc(arg)) == NULL)
+            app_error("mm_malloc failed in run_pairs");
+        mm_free(p);
+    }
+    return 2 * NPAIRS;
+}
+
+/* NBLOCKS mallocs of 64 bytes, then frees in the order set up in order[] */
+enum { FREE_LIFO, FREE_FIFO, FREE_RANDOM };
+
+static void setup_order(long arg)
+{
+    int i, j, t;
+
+    fresh_heap(0);
+    for (i = 0; i < NBLOCKS; i++)
+        order[i] = (arg == FREE_LIFO) ? NBLOCKS - 1 - i : i;
+    if (arg == FREE_RANDOM) {
+        srandom(1);
+        for (i = NBLOCKS - 1; i > 0; i--) {
+            j = random() % (i + 1);
+            t = order[i];
+            order[i] = order[j];
+            order[j] = t;
+        }
+    }
+}
+
+static long run_order(long arg __attribute__((unused)))
+{
+    int i;
+
+    for (i = 0; i < NBLOCKS; i++)
+        if ((blocks[i] = mm_malloc(64)) == NULL)
+            app_error("mm_malloc failed in run_order");
+    for (i = 0; i < NBLOCKS; i++)
+        mm_free(blocks[order[i]]);
+    return 2 * NBLOCKS;
+}
+
+/* Grow one block from 16 bytes to 64 KB, by arg percent per step */
+static long run_realloc(long arg)
+{
+    long ops = 0;
+    size_t size = 16;
+    void *p = mm_malloc(size);
+
+    while (size < (1 << 16)) {
+        size += (size * arg) / 100 + 1;
+        if ((p = mm_realloc(p, size)) == NULL)
+            app_error("mm_realloc failed in run_realloc");
+        ops++;
+    }
+    mm_free(p);
+    return ops;
+}
+
+/*
+ * NBLOCKS/2 free blocks of random sizes up to arg bytes, apart, all on
+ * long seg lists; then malloc/free pairs of such sizes search them
+ */
+static size_t scatter_sizes[NBLOCKS];
+
+static void setup_scatter(long arg)
+{
+    int i;
+
+    fresh_heap(0);
+    srandom(1);
+    for (i = 0; i < NBLOCKS; i++) {
+        scatter_sizes[i] = 16 + random() % (arg - 16);
+        if ((blocks[i] = mm_malloc(scatter_sizes[i])) == NULL)
+            app_error("mm_malloc failed in setup_scatter");
+    }
+    for (i = 0; i < NBLOCKS; i += 2)
+        mm_free(blocks[i]);
+    mm_consolidate();
+}
+
+static long run_scatter(long arg __attribute__((unused)))
+{
+    int i;
+    void *p;
+
+    for (i = 0; i < NBLOCKS; i++) {
+        if ((p = mm_malloc(scatter_sizes[i])) == NULL)
+            app_error("mm_malloc failed in run_scatter");
+        mm_free(p);
+    }
+    return 2 * NBLOCKS;
+}
+
+/* NBATCH blocks of arg bytes from one malloc_batch, back in one
+   free_batch; or with a malloc and a free each */
+static long run_batch(long arg)
+{
+    long i;
+
+    for (i = 0; i < NPAIRS / NBATCH; i++) {
+        if (mm_malloc_batch(arg, NBATCH, blocks) != NBATCH)
+            app_error("mm_malloc_batch failed in run_batch");
+        mm_free_batch(blocks, NBATCH);
+    }
+    return 2 * i * NBATCH;
+}
+
+static long run_batch_loop(long arg)
+{
+    long i;
+    int j;
+
+    for (i = 0; i < NPAIRS / NBATCH; i++) {
+        for (j = 0; j < NBATCH; j++)
+            if ((blocks[j] = mm_malloc(arg)) == NULL)
+                app_error("mm_malloc failed in run_batch_loop");
+        for (j = 0; j < NBATCH; j++)
+            mm_free(blocks[j]);
+    }
+    return 2 * i * NBATCH;
+}
+
+/* NBLOCKS blocks of arg bytes on a heap of their own, dropped with
+   mm_heap_destroy; or on the main heap, with a free each */
+static long run_heap(long arg)
+{
+    mm_heap_t *h;
+    int i;
+
+    if ((h = mm_heap_create()) == NULL)
+        app_error("mm_heap_create failed in run_heap");
+    for (i = 0; i < NBLOCKS; i++)
+        if (mm_heap_malloc(h, arg) == NULL)
+            app_error("mm_heap_malloc failed in run_heap");
+    mm_heap_destroy(h);
+    return 2 * NBLOCKS;
+}
+
+static long run_heap_free(long arg)
+{
+    int i;
+
+    for (i = 0; i < NBLOCKS; i++)
+        if ((blocks[i] = mm_malloc(arg)) == NULL)
+            app_error("mm_malloc failed in run_heap_free");
+    for (i = 0; i < NBLOCKS; i++)
+        mm_free(blocks[i]);
+    return 2 * NBLOCKS;
+}
+
+/* NBLOCKS allocations of arg bytes from a region, then a reset, a few
+   rounds over (compare heap/free/<size>) */
+#define REGION_ROUNDS 8
+static mm_region_t *region;
+
+static void setup_region(long arg __attribute__((unused)))
+{
+    fresh_heap(0);
+    if ((region = mm_region_begin()) == NULL)
+        app_error("mm_region_begin failed in setup_region");
+}
+
+static long run_region(long arg)
+{
+    int i, j;
+
+    for (j = 0; j < REGION_ROUNDS; j++) {
+        for (i = 0; i < NBLOCKS; i++)
+            if (mm_region_alloc(region, arg) == NULL)
+                app_error("mm_region_alloc failed in run_region");
+        mm_region_reset(region);
+    }
+    return 2 * REGION_ROUNDS * NBLOCKS;
+}
+
+/* NBLOCKS objects of arg bytes from a pool, then back to it (compare
+   heap/free/<size>) */
+static mm_pool_t *pool;
+
+static void setup_pool(long arg)
+{
+    fresh_heap(0);
+    if ((pool = mm_pool_create(arg, 0)) == NULL)
+        app_error("mm_pool_create failed in setup_pool");
+}
+
+static long run_pool(long arg __attribute__((unused)))
+{
+    int i;
+
+    for (i = 0; i < NBLOCKS; i++)
+        if ((blocks[i] = mm_pool_alloc(pool)) == NULL)
+            app_error("mm_pool_alloc failed in run_pool");
+    for (i = 0; i < NBLOCKS; i++)
+        mm_pool_free(pool, blocks[i]);
+    return 2 * NBLOCKS;
+}
+
+/* Copy or clear arg bytes with libc, then with memops */
+enum { BULK_MEMCPY, BULK_COPY, BULK_MEMSET, BULK_ZERO };
+static char *bulk_src, *bulk_dst;
+static size_t bulk_size;
+
+static long run_bulk(long arg)
+{
+    int i;
+
+    for (i = 0; i < NBULK; i++) {
+        switch (arg) {
+        case BULK_MEMCPY:
+            memcpy(bulk_dst, bulk_src, bulk_size);
+            break;
+        case BULK_COPY:
+            memops_copy(bulk_dst, bulk_src, bulk_size);
+            break;
+        case BULK_MEMSET:
+            memset(bulk_dst, 0, bulk_size);
+            break;
+        case BULK_ZERO:
+            memops_zero(bulk_dst, bulk_size);
+            break;
+        }
+    }
+    return NBULK;
+}
+
+static void setup_bulk_8m(long arg __attribute__((unused)))
+{
+    bulk_size = MEMOPS_NT_MIN;
+}
+
+static void setup_bulk_32m(long arg __attribute__((unused)))
+{
+    bulk_size = 32 << 20;
+}
+
+/*****************************************************
+ * Benchmarks of the internals
+ *****************************************************/
+
+/* extend_heap on an otherwise empty heap */
+static long run_extend(long arg)
+{
+    long i;
+
+    for (i = 0; i < NEXTEND; i++)
+        if (mm_extend_heap(arg) == NULL)
+            app_error("extend_heap failed");
+    return NEXTEND;
+}
+
+/*
+ * Blocks a, b and c side by side, NBLOCKS/3 times over, with a and c
+ * free; coalescing b then merges all three (splicing a and c out).
+ */
+static void setup_coalesce(long arg __attribute__((unused)))
+{
+    int i;
+
+    fresh_heap(0);
+    for (i = 0; i < NBLOCKS; i++)
+        if ((blocks[i] = mm_malloc(48)) == NULL)
+            app_error("mm_malloc failed in setup_coalesce");
+    for (i = 0; i + 2 < NBLOCKS; i += 3) {
+        mm_free(blocks[i]);
+        mm_free(blocks[i + 2]);
+    }
+    mm_consolidate();
+}
+
+static long run_coalesce(long arg __attribute__((unused)))
+{
+    int i;
+
+    for (i = 1; i + 1 < NBLOCKS; i += 3)
+        mm_coalesce_block(blocks[i]);
+    return NBLOCKS / 3;
+}
+
+/* NBLOCKS/2 free blocks on one seg list, spliced out in random order */
+static void setup_splice(long arg __attribute__((unused)))
+{
+    int i, j, t;
+
+    fresh_heap(0);
+    for (i = 0; i < NBLOCKS; i++)
+        if ((blocks[i] = mm_malloc(48)) == NULL)
+            app_error("mm_malloc failed in setup_splice");
+    for (i = 0; i < NBLOCKS; i += 2) {
+        mm_free(blocks[i]);
+        order[i / 2] = i;
+    }
+    mm_consolidate();
+    srandom(1);
+    for (i = NBLOCKS / 2 - 1; i > 0; i--) {
+        j = random() % (i + 1);
+        t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+}
+
+static long run_splice(long arg __attribute__((unused)))
+{
+    int i;
+
+    for (i = 0; i < NBLOCKS / 2; i++)
+        mm_splice_block(blocks[order[i]]);
+    return NBLOCKS / 2;
+}
+
+/*****************************************************
+ * Checks
+ *****************************************************/
+
+static int failures = 0;
+static size_t check_sizes[NBLOCKS];
+static int check_owner[NBLOCKS];
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+/* Run the heap checker on h (the main heap if NULL) */
+static void check_heap(mm_heap_t *h, const char *what)
+{
+    check((h ? mm_heap_checkheap(h, 0) : mm_checkheap(0)) == 0, what);
+}
+
+/* A pattern of n bytes that tells block id apart from its neighbours */
+static void fill(void *p, size_t n, int id)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        ((unsigned char *)p)[i] = id * 7 + i;
+}
+
+static int intact(const void *p, size_t n, int id)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        if (((const unsigned char *)p)[i] != (unsigned char)(id * 7 + i))
+            return 0;
+    return 1;
+}
+
+static int zeroed(const void *p, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        if (((const unsigned char *)p)[i] != 0)
+            return 0;
+    return 1;
+}
+
+/*
+ * check_calloc - Write over every byte malloc_usable_size gives a block,
+ * slack included, free it, and calloc the same size; the block calloc
+ * returns must be zero all over. First the case of a block that takes
+ * unsplit slack from the wilderness, then blocks of random sizes.
+ */
+static void check_calloc(void)
+{
+    size_t n;
+    void *p;
+    int i;
+
+    fresh_heap(0);
+    if (mm_malloc(100) == NULL || (p = mm_malloc(536)) == NULL)
+        app_error("mm_malloc failed in check_calloc");
+    n = mm_malloc_usable_size(p);
+    memset(p, 0xab, n);
+    mm_free(p);
+    if ((p = mm_calloc(1, n)) == NULL)
+        app_error("mm_calloc failed in check_calloc");
+    check(zeroed(p, n), "calloc left the slack of a freed block dirty");
+
+    fresh_heap(0);
+    srandom(4);
+    for (i = 0; i < NBLOCKS; i++) {
+        check_sizes[i] = 1 + random() % 2000;
+        if ((blocks[i] = mm_malloc(check_sizes[i])) == NULL)
+            app_error("mm_malloc failed in check_calloc");
+        memset(blocks[i], 0xab, mm_malloc_usable_size(blocks[i]));
+        if (random() % 2) {
+            mm_free(blocks[i]);
+            if ((blocks[i] = mm_calloc(1, check_sizes[i])) == NULL)
+                app_error("mm_calloc failed in check_calloc");
+            check(zeroed(blocks[i], check_sizes[i]),
+                  "calloc returned a block that is not zero");
+        }
+    }
+    check_heap(NULL, "heap after callocs of dirty blocks");
+}
+
+/*
+ * check_heaps - NHEAPS heaps of their own and the main heap, with
+ * blocks of random sizes malloced, calloced, realloced and freed on all
+ * of them at once; every block must keep its pattern, and every heap
+ * must pass the heap checker, as the heaps come and go.
+ */
+static void check_heaps(void)
+{
+    mm_heap_t *heaps[NHEAPS];
+    int round, i, j, k, ok;
+    void *p;
+
+    fresh_heap(0);
+    srandom(1);
+    for (round = 0; round < CHECK_ROUNDS; round++) {
+        for (k = 0; k < NHEAPS; k++) {
+            if ((heaps[k] = mm_heap_create()) == NULL)
+                app_error("mm_heap_create failed in check_heaps");
+            check_heap(heaps[k], "new heap");
+        }
+
+        /* owner NHEAPS is the main heap */
+        for (i = 0; i < NBLOCKS; i++) {
+            k = check_owner[i] = random() % (NHEAPS + 1);
+            check_sizes[i] = 1 + random() % 2000;
+            if (k == NHEAPS)
+                p = mm_malloc(check_sizes[i]);
+            else if (i % 5 == 0)
+                p = mm_heap_calloc(heaps[k], 1, check_sizes[i]);
+            else
+                p = mm_heap_malloc(heaps[k], check_sizes[i]);
+            if ((blocks[i] = p) == NULL)
+                app_error("malloc failed in check_heaps");
+            if (i % 5 == 0 && k < NHEAPS)
+                check(zeroed(p, check_sizes[i]),
+                      "mm_heap_calloc left a block unzeroed");
+            fill(p, check_sizes[i], i);
+
+            /* now and then free or resize an older block */
+            j = random() % (i + 1);
+            if (blocks[j] == NULL || random() % 4)
+                continue;
+            k = check_owner[j];
+            if (random() % 2) {
+                if (k == NHEAPS)
+                    mm_free(blocks[j]);
+                else
+                    mm_heap_free(heaps[k], blocks[j]);
+                blocks[j] = NULL;
+                continue;
+            }
+            ok = intact(blocks[j], check_sizes[j], j);
+            check_sizes[j] = 1 + random() % 4000;
+            p = (k == NHEAPS) ? mm_realloc(blocks[j], check_sizes[j]) :
+                mm_heap_realloc(heaps[k], blocks[j], check_sizes[j]);
+            if ((blocks[j] = p) == NULL)
+                app_error("realloc failed in check_heaps");
+            check(ok, "a block lost its pattern before realloc");
+            fill(p, check_sizes[j], j);
+        }
+
+        for (i = 0; i < NBLOCKS; i++)
+            if (blocks[i])
+                check(intact(blocks[i], check_sizes[i], i),
+                      "a block on one heap was overwritten");
+        for (k = 0; k < NHEAPS; k++)
+            check_heap(heaps[k], "heap after its mallocs and frees");
+        check_heap(NULL, "main heap next to heaps of their own");
+
+        /* drop every other heap, then check what is left */
+        for (k = round % 2; k < NHEAPS; k += 2) {
+            mm_heap_destroy(heaps[k]);
+            heaps[k] = NULL;
+        }
+        for (i = 0; i < NBLOCKS; i++)
+            if (blocks[i] && (check_owner[i] == NHEAPS ||
+                              heaps[check_owner[i]] != NULL))
+                check(intact(blocks[i], check_sizes[i], i),
+                      "a block changed when another heap was destroyed");
+        for (k = 0; k < NHEAPS; k++)
+            if (heaps[k])
+                check_heap(heaps[k], "heap after another was destroyed");
+        check_heap(NULL, "main heap after heaps were destroyed");
+
+        for (k = 0; k < NHEAPS; k++)
+            if (heaps[k])
+                mm_heap_destroy(heaps[k]);
+        for (i = 0; i < NBLOCKS; i++)
+            if (blocks[i] && check_owner[i] == NHEAPS)
+                mm_free(blocks[i]);
+        check_heap(NULL, "main heap after its blocks were freed");
+    }
+}
+
+/*
+ * check_regions - Fill a region with small blocks and, every so often,
+ * one bigger than a quarter of the largest chunk, which gets a chunk of
+ * its own, with blocks malloced on the main heap in between; then reset
+ * it. Every block must keep its pattern, the heap must pass the checker
+ * after each reset, and the same rounds over again must not grow the
+ * heap, which they would if a reset kept any chunk but the newest.
+ */
+static void check_regions(void)
+{
+    mm_region_t *r;
+    size_t heapsize = 0;
+    int round, i;
+
+    fresh_heap(0);
+    if ((r = mm_region_begin()) == NULL)
+        app_error("mm_region_begin failed in check_regions");
+    for (round = 0; round < CHECK_ROUNDS; round++) {
+        srandom(2);
+        /* every eighth block on the main heap, every 64th a big one */
+        for (i = 0; i < NBLOCKS; i++) {
+            check_owner[i] = (i % 8 == 7);
+            if (i % 64 == 30)
+                check_sizes[i] = (256 << 10) + random() % (256 << 10);
+            else
+                check_sizes[i] = 1 + random() % 200;
+            blocks[i] = check_owner[i] ? mm_malloc(check_sizes[i]) :
+                mm_region_alloc(r, check_sizes[i]);
+            if (blocks[i] == NULL)
+                app_error("allocation failed in check_regions");
+            fill(blocks[i], check_sizes[i], i);
+        }
+        for (i = 0; i < NBLOCKS; i++)
+            check(intact(blocks[i], check_sizes[i], i),
+                  "a region block was overwritten");
+        mm_region_reset(r);
+        check_heap(NULL, "heap after mm_region_reset");
+        for (i = 0; i < NBLOCKS; i++)
+            if (check_owner[i])
+                check(intact(blocks[i], check_sizes[i], i),
+                      "mm_region_reset overwrote a block of the heap");
+        for (i = 0; i < NBLOCKS; i++)
+            if (check_owner[i])
+                mm_free(blocks[i]);
+        check_heap(NULL, "heap after a region round");
+        /* a round whose big chunks leaked would add some 24 MB */
+        if (round == 1)
+            heapsize = mem_heapsize();
+        else if (round > 1)
+            check(mem_heapsize() <= heapsize + (1 << 20),
+                  "the heap grew over the same region rounds");
+    }
+    mm_region_end(r);
+    check_heap(NULL, "heap after mm_region_end");
+}
+
+/*
+ * check_pools - For each object size and alignment, fill slabs of a
+ * pool with objects, each with a pattern, next to blocks malloced on
+ * the main heap; then give the objects back in random order, which
+ * empties slabs and sends all but one back to the heap. Every object
+ * must be aligned and keep its pattern, the stats must add up, and the
+ * heap must pass the checker along the way.
+ */
+static void check_pools(void)
+{
+    static const size_t sizes[] = { 24, 200, 0 };
+    static const size_t aligns[] = { 0, 64, 4096 };
+    mm_pool_t *p;
+    mm_pool_stats_t st;
+    int a, s, i, j, t, n;
+
+    for (a = 0; a < 3; a++) {
+        for (s = 0; sizes[s]; s++) {
+            fresh_heap(0);
+            srandom(3);
+            if ((p = mm_pool_create(sizes[s], aligns[a])) == NULL)
+                app_error("mm_pool_create failed in check_pools");
+            n = (aligns[a] >= 4096) ? NBLOCKS / 8 : NBLOCKS;
+
+            /* every eighth block on the main heap */
+            for (i = 0; i < n; i++) {
+                check_owner[i] = (i % 8 == 7);
+                check_sizes[i] = sizes[s];
+                if (check_owner[i])
+                    check_sizes[i] = 1 + random() % 500;
+                blocks[i] = check_owner[i] ? mm_malloc(check_sizes[i]) :
+                    mm_pool_alloc(p);
+                if (blocks[i] == NULL)
+                    app_error("allocation failed in check_pools");
+                if (!check_owner[i] && aligns[a])
+                    check((size_t)blocks[i] % aligns[a] == 0,
+                          "a pool object is not aligned");
+                fill(blocks[i], check_sizes[i], i);
+                order[i] = i;
+            }
+            for (i = 0; i < n; i++)
+                check(intact(blocks[i], check_sizes[i], i),
+                      "a pool object or a block next to it was overwritten");
+            check_heap(NULL, "heap with a full pool");
+
+            /* pool objects back in random order, checking halfway */
+            for (i = n - 1; i > 0; i--) {
+                j = random() % (i + 1);
+                t = order[i];
+                order[i] = order[j];
+                order[j] = t;
+            }
+            for (i = 0; i < n; i++) {
+                if (i == n / 2) {
+                    for (j = 0; j < n; j++)
+                        if (blocks[j])
+                            check(intact(blocks[j], check_sizes[j], j),
+                                  "freeing pool objects overwrote another");
+                    check_heap(NULL, "heap with a half empty pool");
+                }
+                if (check_owner[order[i]])
+                    continue;
+                mm_pool_free(p, blocks[order[i]]);
+                blocks[order[i]] = NULL;
+            }
+            mm_pool_stats(p, &st);
+            check(st.in_use == 0 && st.allocs == st.frees,
+                  "pool stats do not add up");
+            check(st.slabs <= 1, "an empty pool holds more than one slab");
+            check(st.slabs_freed > 0, "no empty slab went back to the heap");
+            check_heap(NULL, "heap after a pool emptied");
+
+            mm_pool_destroy(p);
+            for (i = 0; i < n; i++) {
+                if (!check_owner[i])
+                    continue;
+                check(intact(blocks[i], check_sizes[i], i),
+                      "the pool overwrote a block of the heap");
+                mm_free(blocks[i]);
+            }
+            check_heap(NULL, "heap after mm_pool_destroy");
+        }
+    }
+}
+
+/*
+ * run_checks - Run every check; return the number of failures
+ */
+static int run_checks(void)
+{
+    int before;
+
+    check_calloc();
+    printf("calloc: %s\n", failures ? "FAILED" : "ok");
+    before = failures;
+    check_heaps();
+    printf("heaps: %s\n", failures > before ? "FAILED" : "ok");
+    before = failures;
+    check_regions();
+    printf("regions: %s\n", failures > before ? "FAILED" : "ok");
+    before = failures;
+    check_pools();
+    printf("pools: %s\n", failures > before ? "FAILED" : "ok");
+    return failures;
+}
+
+/*****************************************************
+ * The harness
+ *****************************************************/
+
+static void add_bench(const char *name, void (*setup)(long),
+                      long (*run)(long), long arg)
+{
+    if (nbenches == MAXBENCH)
+        app_error("too many benchmarks");
+    snprintf(benches[nbenches].name, sizeof(benches[nbenches].name),
+             "%s", name);
+    benches[nbenches].setup = setup;
+    benches[nbenches].run = run;
+    benches[nbenches].arg = arg;
+    nbenches++;
+}
+
+/*
+ * payload_for - Largest request whose block is at most asize bytes
+ */
+static size_t payload_for(size_t asize)
+{
+    size_t size = asize;
+
+    while (size > 1 && mm_block_size(size) > asize)
+        size--;
+    return size;
+}
+
+static void add_all_benches(void)
+{
+    static const long pair_sizes[] = { 8, 16, 32, 64, 128, 256, 512,
+                                       1024, 4096, 16384, 0 };
+    char name[64];
+    int i;
+    size_t size;
+
+    for (i = 0; pair_sizes[i]; i++) {
+        sprintf(name, "pair/%ld", pair_sizes[i]);
+        add_bench(name, fresh_heap, run_pairs, pair_sizes[i]);
+    }
+
+    /* both sides of every seg list boundary */
+    for (i = 0; i < mm_num_classes() - 1; i++) {
+        size = payload_for(mm_class_max(i));
+        sprintf(name, "class%d/max%zu/%zu", i + 1, mm_class_max(i), size);
+        add_bench(name, fresh_heap, run_pairs, size);
+        sprintf(name, "class%d/max%zu/%zu", i + 2, mm_class_max(i), size + 1);
+        add_bench(name, fresh_heap, run_pairs, size + 1);
+    }
+
+    add_bench("free/lifo", setup_order, run_order, FREE_LIFO);
+    add_bench("free/fifo", setup_order, run_order, FREE_FIFO);
+    add_bench("free/random", setup_order, run_order, FREE_RANDOM);
+
+    add_bench("scatter/256", setup_scatter, run_scatter, 256);
+    add_bench("scatter/2048", setup_scatter, run_scatter, 2048);
+
+    add_bench("batch/48", fresh_heap, run_batch, 48);
+    add_bench("batch/loop/48", fresh_heap, run_batch_loop, 48);
+    add_bench("batch/1000", fresh_heap, run_batch, 1000);
+    add_bench("batch/loop/1000", fresh_heap, run_batch_loop, 1000);
+
+    add_bench("heap/destroy/48", fresh_heap, run_heap, 48);
+    add_bench("heap/free/48", fresh_heap, run_heap_free, 48);
+    add_bench("heap/destroy/1000", fresh_heap, run_heap, 1000);
+    add_bench("heap/free/1000", fresh_heap, run_heap_free, 1000);
+
+    add_bench("region/48", setup_region, run_region, 48);
+    add_bench("region/1000", setup_region, run_region, 1000);
+
+    add_bench("pool/48", setup_pool, run_pool, 48);
+    add_bench("pool/1000", setup_pool, run_pool, 1000);
+
+    add_bench("realloc/+10%", fresh_heap, run_realloc, 10);
+    add_bench("realloc/+50%", fresh_heap, run_realloc, 50);
+    add_bench("realloc/x2", fresh_heap, run_realloc, 100);
+
+    add_bench("bulk/memcpy/8M", setup_bulk_8m, run_bulk, BULK_MEMCPY);
+    add_bench("bulk/copy/8M", setup_bulk_8m, run_bulk, BULK_COPY);
+    add_bench("bulk/memset/8M", setup_bulk_8m, run_bulk, BULK_MEMSET);
+    add_bench("bulk/zero/8M", setup_bulk_8m, run_bulk, BULK_ZERO);
+    add_bench("bulk/memcpy/32M", setup_bulk_32m, run_bulk, BULK_MEMCPY);
+    add_bench("bulk/copy/32M", setup_bulk_32m, run_bulk, BULK_COPY);
+    add_bench("bulk/memset/32M", setup_bulk_32m, run_bulk, BULK_MEMSET);
+    add_bench("bulk/zero/32M", setup_bulk_32m, run_bulk, BULK_ZERO);
+
+    add_bench("extend_heap", fresh_heap, run_extend, EXTEND_WORDS);
+    add_bench("coalesce", setup_coalesce, run_coalesce, 0);
+    add_bench("splice_block", setup_splice, run_splice, 0);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * run_bench - Warm up, then time reps runs and print ns/op
+ */
+static void run_bench(bench_t *b)
+{
+    double ns[reps];
+    double cyc;
+    long ops = 0;
+    int i;
+
+    for (i = 0; i < warmup; i++) {
+        if (b->setup)
+            b->setup(b->arg);
+        b->run(b->arg);
+    }
+    for (i = 0; i < reps; i++) {
+        if (b->setup)
+            b->setup(b->arg);
+        start_counter();
+        ops = b->run(b->arg);
+        cyc = get_counter();
+        ns[i] = cyc * 1e3 / Mhz / ops;
+    }
+    qsort(ns, reps, sizeof(double), cmp_double);
+    printf("%-28s %10.2f %10.2f %10.2f %10ld\n", b->name,
+           ns[0], ns[reps / 2], ns[reps - 1], ops);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mm-bench [-hc] [-w <n>] [-r <n>] [-b <prefix>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-w <n>       Untimed warmup runs (default %d).\n", WARMUP);
+    fprintf(stderr, "\t-r <n>       Timed repetitions (default %d).\n", REPS);
+    fprintf(stderr, "\t-b <prefix>  Only run benchmarks whose name starts with <prefix>.\n");
+    fprintf(stderr, "\t-c           Check the heap through heaps, regions and pools; time nothing.\n");
+    fprintf(stderr, "\t-h           Print this message.\n");
+}
+
+int main(int argc, char **argv)
+{
+    char c;
+    char *prefix = NULL;
+    int i, checks = 0;
+
+    while ((c = getopt(argc, argv, "w:r:b:ch")) != EOF) {
+        switch (c) {
+        case 'w':
+            warmup = atoi(optarg);
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            if (reps < 1)
+                reps = 1;
+            break;
+        case 'b':
+            prefix = optarg;
+            break;
+        case 'c':
+            checks = 1;
+            break;
+        case 'h':
+            usage();
+            exit(0);
+        default:
+            usage();
+            exit(1);
+        }
+    }
+
+    if (checks) {
+        mem_init();
+        i = run_checks();
+        mem_deinit();
+        return i ? 1 : 0;
+    }
+
+    pin_cpu(PIN_CPU, 0);
+    Mhz = mhz(0);
+    mem_init();
+    add_all_benches();
+    bulk_src = calloc(32 << 20, 1);
+    bulk_dst = calloc(32 << 20, 1);
+    if (bulk_src == NULL || bulk_dst == NULL)
+        app_error("calloc failed for the bulk benchmarks");
+    printf("memops engine: %s\n", memops_engine());
+
+    printf("%-28s %10s %10s %10s %10s\n", "benchmark",
+           "min ns/op", "median", "max", "ops/run");
+    for (i = 0; i < nbenches; i++)
+        if (!prefix || strncmp(benches[i].name, prefix, strlen(prefix)) == 0)
+            run_bench(&benches[i]);
+
+    free(bulk_src);
+    free(bulk_dst);
+    mem_deinit();
+    return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * mm-internals.h - Entry points into the internals of mm.c
+ *
+ * These exist only when mm.c is compiled with -DMM_INTERNALS, which is
+ * how the microbenchmarks (mm-bench.c) and the other tools get at the
+ * heap's building blocks without going through malloc and free.
+ */
+#ifndef __MM_INTERNALS_H_
+#define __MM_INTERNALS_H_
+
+#include <stddef.h>
+
+/* Size of the block (header and footer included) that malloc would
+   carve for a request of size bytes */
+size_t mm_block_size(size_t size);
+
+/* Number of seg lists, and the largest block size that each one holds
+   (the last one has no limit and reports (size_t)-1) */
+int mm_num_classes(void);
+size_t mm_class_max(int i);
+
+/* Seg list that a block of asize bytes belongs to */
+int mm_class_of(size_t asize);
+
+/* extend_heap: grow the heap by words words and return the new free
+   block, coalesced with the old top block; it is the wilderness, which
+   is on no seg list */
+void *mm_extend_heap(size_t words);
+
+/* coalesce: mark the allocated block bp free and merge it with its
+   free neighbors, which leaves the result on no seg list */
+void *mm_coalesce_block(void *bp);
+
+/* splice_block: take the free block bp off its seg list */
+void *mm_splice_block(void *bp);
+
+/* consolidate: free every block waiting on the quick-lists into the seg
+   lists */
+void mm_consolidate(void);
+
+/* What the free-list searches did since the last reset */
+typedef struct {
+    long searches;     /* searches for a fit */
+    long misses;       /* searches that found none */
+    long lists;        /* seg lists looked in */
+    long visited;      /* free blocks looked at */
+    long max_visited;  /* most free blocks looked at in one search */
+    int depth;         /* current depth of good/adaptive fit, else 0 */
+    long grows;        /* times malloc grew the heap */
+    size_t grow_size;  /* current least growth, in bytes */
+} mm_fit_stats_t;
+
+/* Fit policies by name ("first", "next", "best", "good", "adaptive"):
+   the i-th, or NULL past the last one; the current one; and switch to
+   one (between traces, before mm_init), returning -1 if unknown */
+const char *mm_fit_policy_name(int i);
+const char *mm_fit_policy(void);
+int mm_set_fit_policy(const char *name);
+
+void mm_get_fit_stats(mm_fit_stats_t *stats);
+void mm_reset_fit_stats(void);
+
+/* The parameters mm-tune searches over */
+#define MM_MAX_CLASSES 64
+typedef struct {
+    int nbounds;                      /* seg lists - 1, fixed by the build */
+    size_t class_max[MM_MAX_CLASSES]; /* increasing; the last list is open */
+    size_t chunksize;                 /* CHUNKSIZE */
+    int search_depth;                 /* SEARCH_DEPTH */
+} mm_params_t;
+
+/* Current parameters */
+void mm_get_params(mm_params_t *params);
+
+/* Change the parameters; only in builds with -DMM_TUNABLE as well, and
+   only between traces (call mm_init afterwards) */
+void mm_set_params(const mm_params_t *params);
+
+#endif /* __MM_INTERNALS_H_ */
@@ -30,18 +30,30 @@
 
 /* do not change the following! */
 #ifdef DRIVER
-/* create aliases for driver tests */
-#define malloc mm_malloc
-#define free mm_free
-#define realloc mm_realloc
-#define calloc mm_calloc
+/* create aliases for driver tests; the naive package is linked into the
+ * driver next to mm.c, so it gets its own names (see backends.c) */
+#define malloc naive_malloc
+#define free naive_free
+#define realloc naive_realloc
+#define calloc naive_calloc
+#define memalign naive_memalign
+#define free_sized naive_free_sized
+#define malloc_usable_size naive_malloc_usable_size
+#define malloc_batch naive_malloc_batch
+#define free_batch naive_free_batch
+#define mm_init naive_init
+#define mm_checkheap naive_checkheap
 #endif /* def DRIVER */
 
-/* single word (4) or double word (8) alignment */
+/* double word (8) alignment, or MM_ALIGNMENT as mm.c */
+#ifdef MM_ALIGNMENT
+#define ALIGNMENT MM_ALIGNMENT
+#else
 #define ALIGNMENT 8
+#endif
 
 /* rounds up to the nearest multiple of ALIGNMENT */
-#define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~0x7)
+#define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~(size_t)(ALIGNMENT-1))
 
 
 #define SIZE_T_SIZE (ALIGN(sizeof(size_t)))
@@ -62,7 +74,7 @@ int mm_init(void)
  */
 void *malloc(size_t size)
 {
-  int newsize = ALIGN(size + SIZE_T_SIZE);
+  size_t newsize = ALIGN(size + SIZE_T_SIZE);
   unsigned char *p = mem_sbrk(newsize);
   //dbg_printf("malloc %u => %p\n", size, p);
 
@@ -138,11 +150,73 @@ void *calloc (size_t nmemb, size_t size)
   return newptr;
 }
 
+/*
+ * memalign - Allocate a block by incrementing the brk pointer past
+ *      enough slack to align it.
+ */
+void *memalign(size_t alignment, size_t size)
+{
+  unsigned char *p;
+
+  if (alignment == 0 || (alignment & (alignment - 1)))
+    return NULL;
+  if (alignment < ALIGNMENT)
+    alignment = ALIGNMENT;
+  p = mem_sbrk(ALIGN(size + SIZE_T_SIZE + alignment));
+  if ((long)p < 0)
+    return NULL;
+  p = (unsigned char *)(((size_t)p + SIZE_T_SIZE + alignment - 1) &
+                        ~(alignment - 1));
+  *SIZE_PTR(p) = size;
+  return p;
+}
+
+/*
+ * free_sized - Nothing is freed, whatever the size.
+ */
+void free_sized(void *ptr, size_t size)
+{
+  (void)size;
+  free(ptr);
+}
+
+/*
+ * malloc_usable_size - Only what was asked for; the size word says no
+ *      more.
+ */
+size_t malloc_usable_size(void *ptr)
+{
+  return ptr ? *SIZE_PTR(ptr) : 0;
+}
+
+/*
+ * malloc_batch - One malloc after another, until one fails.
+ */
+size_t malloc_batch(size_t size, size_t n, void **out)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    if ((out[i] = malloc(size)) == NULL)
+      break;
+  return i;
+}
+
+/*
+ * free_batch - Nothing to free here either.
+ */
+void free_batch(void **ptrs, size_t n)
+{
+  (void)ptrs;
+  (void)n;
+}
+
 /*
  * mm_checkheap - There are no bugs in my code, so I don't need to check,
  *      so nah!
  */
-void mm_checkheap(int verbose){
+int mm_checkheap(int verbose){
 	/*Get gcc to be quiet. */
 	verbose = verbose;
+	return 0;
 }
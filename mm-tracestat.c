@@ -0,0 +1,372 @@
+/*
+ * mm-tracestat.c - Allocation profile of .rep trace files
+ *
+ * For each trace, reports:
+ *  - requests and bytes per seg list class (as mm.c would size them)
+ *  - object lifetimes, in ops from first allocation to free
+ *  - the peak live set, in blocks and in payload bytes
+ *  - how much each realloc grows or shrinks its block
+ *  - the order of frees: LIFO (newest live block), FIFO (oldest live
+ *    block) or neither
+ *  - how often a freed block size is asked for again within a window
+ *    of ops, which is what quick-lists and exact-size reuse pay off on
+ *
+ * With -p, each trace is also replayed through mm.c under every fit
+ * policy, reporting the utilization and how long the searches were.
+ *
+ * The numbers tell which classes and policies matter for a workload.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "mm.h"
+#include "mm-internals.h"
+#include "memlib.h"
+
+#define REUSE_WINDOW  16  /* default -w */
+#define LIFE_BUCKETS  24  /* lifetimes in powers of two, up to 8M ops */
+#define GROW_BUCKETS  7
+
+/* Realloc growth ratio buckets: new size / old size */
+static const double grow_limit[GROW_BUCKETS] = {
+    1.0, 1.0 + 1e-9, 1.25, 1.5, 2.0, 4.0, 1e300
+};
+static const char *grow_name[GROW_BUCKETS] = {
+    "shrink", "same", "<=1.25x", "<=1.5x", "<=2x", "<=4x", ">4x"
+};
+
+/* Block sizes waiting to be asked for again, see reuse_free */
+typedef struct {
+    size_t asize;
+    int pending;    /* frees of this size not yet reused */
+    int last_free;  /* op of the most recent one */
+} reuse_t;
+
+static reuse_t *reuse_tab;
+static size_t reuse_cap;
+static int window = REUSE_WINDOW;
+static int fit_policies = 0;
+
+static void app_error(const char *msg)
+{
+    fprintf(stderr, "%s\n", msg);
+    exit(1);
+}
+
+/*
+ * reuse_slot - Open-addressing lookup of the entry for asize
+ */
+static reuse_t *reuse_slot(size_t asize)
+{
+    size_t h = (asize / 8) * 2654435761u;
+
+    for (h &= reuse_cap - 1; reuse_tab[h].asize != 0 &&
+             reuse_tab[h].asize != asize; h = (h + 1) & (reuse_cap - 1))
+        ;
+    reuse_tab[h].asize = asize;
+    return &reuse_tab[h];
+}
+
+static void reuse_free(size_t asize, int op)
+{
+    reuse_t *r = reuse_slot(asize);
+    r->pending++;
+    r->last_free = op;
+}
+
+/* Return 1 if a block of asize was freed within the window */
+static int reuse_alloc(size_t asize, int op)
+{
+    reuse_t *r = reuse_slot(asize);
+    if (r->pending > 0 && op - r->last_free <= window) {
+        r->pending--;
+        return 1;
+    }
+    return 0;
+}
+
+static int log2_bucket(long x)
+{
+    int b = 0;
+    while (x > 1 && b < LIFE_BUCKETS - 1) {
+        x >>= 1;
+        b++;
+    }
+    return b;
+}
+
+/*
+ * profile - Replay one trace without an allocator and print its profile
+ */
+static void profile(trace_t *trace)
+{
+    int nclasses = mm_num_classes();
+    long class_reqs[nclasses], class_bytes[nclasses];
+    long life[LIFE_BUCKETS], grow[GROW_BUCKETS];
+    long nalloc = 0, nrealloc = 0, nfree = 0, never_freed = 0;
+    long lifo = 0, fifo = 0, other = 0, reused = 0, nfreed_sizes = 0;
+    long live = 0, peak_live = 0;
+    size_t live_bytes = 0, peak_bytes = 0, asize;
+    int peak_op = 0, i, k, c, b, index;
+    int n = trace->num_ids;
+    double ratio;
+
+    /* per id: birth op, payload size, and its place in allocation order */
+    int *born = malloc(n * sizeof(int));
+    size_t *size = calloc(n, sizeof(size_t));
+    char *is_live = calloc(n, 1);
+    int *next = malloc(n * sizeof(int));
+    int *prev = malloc(n * sizeof(int));
+    int head = -1, tail = -1;
+    if (!born || !size || !is_live || !next || !prev)
+        app_error("malloc failed in profile");
+
+    for (reuse_cap = 1024; reuse_cap < 4 * (size_t)n; reuse_cap *= 2)
+        ;
+    if ((reuse_tab = calloc(reuse_cap, sizeof(reuse_t))) == NULL)
+        app_error("malloc failed in profile");
+
+    memset(class_reqs, 0, sizeof(class_reqs));
+    memset(class_bytes, 0, sizeof(class_bytes));
+    memset(life, 0, sizeof(life));
+    memset(grow, 0, sizeof(grow));
+
+    for (i = 0; i < trace->num_ops; i++) {
+        traceop_t *op = &trace->ops[i];
+        int batch = (op->type == BATCH_ALLOC ||
+                     op->type == BATCH_FREE) ? op->count : 1;
+
+        /* A batch counts as one request per id */
+        for (k = 0; k < batch; k++) {
+            index = op->index + k;
+
+            switch (op->type) {
+            case ALLOC:
+            case MEMALIGN:
+            case BATCH_ALLOC:
+            case REALLOC:
+                if (op->type == REALLOC && is_live[index]) {
+                    nrealloc++;
+                    ratio = size[index] ?
+                        (double)op->size / size[index] : 1e300;
+                    for (b = 0; ratio > grow_limit[b]; b++)
+                        ;
+                    grow[b]++;
+                    live_bytes -= size[index];
+                    if (op->size == 0)
+                        goto do_free;
+                } else {
+                    if (op->type == REALLOC)
+                        nrealloc++;
+                    else
+                        nalloc++;
+                    born[index] = i;
+                    is_live[index] = 1;
+                    live++;
+                    prev[index] = tail;
+                    next[index] = -1;
+                    if (tail >= 0)
+                        next[tail] = index;
+                    else
+                        head = index;
+                    tail = index;
+                }
+                asize = mm_block_size(op->size);
+                c = mm_class_of(asize);
+                class_reqs[c]++;
+                class_bytes[c] += op->size;
+                reused += reuse_alloc(asize, i);
+                size[index] = op->size;
+                live_bytes += op->size;
+                break;
+
+            case FREE:
+            case FREE_SIZED:
+            case BATCH_FREE:
+                if (index < 0 || !is_live[index])
+                    break;
+                live_bytes -= size[index];
+            do_free:
+                nfree++;
+                if (index == tail)
+                    lifo++;
+                else if (index == head)
+                    fifo++;
+                else
+                    other++;
+                life[log2_bucket(i - born[index])]++;
+                reuse_free(mm_block_size(size[index]), i);
+                nfreed_sizes++;
+
+                is_live[index] = 0;
+                live--;
+                if (prev[index] >= 0)
+                    next[prev[index]] = next[index];
+                else
+                    head = next[index];
+                if (next[index] >= 0)
+                    prev[next[index]] = prev[index];
+                else
+                    tail = prev[index];
+                break;
+            }
+
+            if (live_bytes > peak_bytes) {
+                peak_bytes = live_bytes;
+                peak_op = i;
+            }
+            if (live > peak_live)
+                peak_live = live;
+        }
+    }
+    for (index = 0; index < n; index++)
+        never_freed += is_live[index];
+
+    printf("%s: %d ops (%ld malloc, %ld realloc, %ld free)\n",
+           trace->filename, trace->num_ops, nalloc, nrealloc, nfree);
+
+    printf("  peak live set: %ld blocks, %zu bytes (at op %d)\n",
+           peak_live, peak_bytes, peak_op);
+
+    printf("  size classes:\n");
+    for (c = 0; c < nclasses; c++) {
+        if (class_reqs[c] == 0)
+            continue;
+        if (mm_class_max(c) == (size_t)-1)
+            printf("    %2d  >%-9zu", c + 1, mm_class_max(c - 1));
+        else
+            printf("    %2d  <=%-8zu", c + 1, mm_class_max(c));
+        printf(" %8ld reqs %5.1f%%  avg %9.1f bytes\n", class_reqs[c],
+               100.0 * class_reqs[c] / (nalloc + nrealloc),
+               (double)class_bytes[c] / class_reqs[c]);
+    }
+
+    printf("  lifetimes (ops):");
+    for (b = 0; b < LIFE_BUCKETS; b++)
+        if (life[b])
+            printf(" <%ld:%ld", 2L << b, life[b]);
+    printf(" never:%ld\n", never_freed);
+
+    if (nrealloc) {
+        printf("  realloc growth:");
+        for (b = 0; b < GROW_BUCKETS; b++)
+            if (grow[b])
+                printf(" %s:%ld", grow_name[b], grow[b]);
+        printf("\n");
+    }
+
+    if (nfree) {
+        printf("  free order: LIFO %.1f%%  FIFO %.1f%%  other %.1f%%\n",
+               100.0 * lifo / nfree, 100.0 * fifo / nfree,
+               100.0 * other / nfree);
+        printf("  freed size asked for again within %d ops: %.1f%%\n",
+               window, 100.0 * reused / nfreed_sizes);
+    }
+    printf("\n");
+
+    free(born);
+    free(size);
+    free(is_live);
+    free(next);
+    free(prev);
+    free(reuse_tab);
+}
+
+/*
+ * replay - Run the trace through mm.c; return the utilization, or -1
+ *     if a request failed
+ */
+static double replay(trace_t *trace)
+{
+    long hwm;
+
+    if (trace_replay(trace, &hwm) < 0)
+        return -1;
+    return (double)hwm / mem_heapsize();
+}
+
+/*
+ * fit_report - Replay the trace under each fit policy of mm.c
+ */
+static void fit_report(trace_t *trace)
+{
+    char saved[32];
+    const char *name;
+    mm_fit_stats_t st;
+    double util;
+    int i;
+
+    snprintf(saved, sizeof(saved), "%s", mm_fit_policy());
+    printf("  fit policies:    util  searches  misses  lists/srch  "
+           "blocks/srch  max  depth  grows\n");
+    for (i = 0; (name = mm_fit_policy_name(i)) != NULL; i++) {
+        mm_set_fit_policy(name);
+        mm_reset_fit_stats();
+        util = replay(trace);
+        mm_get_fit_stats(&st);
+        if (util < 0) {
+            printf("    %-10s  failed\n", name);
+            continue;
+        }
+        printf("    %-10s %5.1f%% %9ld %7ld %11.2f %12.2f %4ld %6d %6ld\n",
+               name, 100 * util, st.searches, st.misses,
+               st.searches ? (double)st.lists / st.searches : 0,
+               st.searches ? (double)st.visited / st.searches : 0,
+               st.max_visited, st.depth, st.grows);
+    }
+    mm_set_fit_policy(saved);
+    printf("\n");
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mm-tracestat [-hp] [-w <ops>] <file>...\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-w <ops>  Reuse window in ops (default %d).\n",
+            REUSE_WINDOW);
+    fprintf(stderr, "\t-p        Replay through mm.c under each fit policy.\n");
+    fprintf(stderr, "\t-h        Print this message.\n");
+}
+
+int main(int argc, char **argv)
+{
+    char c;
+    int i;
+
+    while ((c = getopt(argc, argv, "w:ph")) != EOF) {
+        switch (c) {
+        case 'w':
+            window = atoi(optarg);
+            break;
+        case 'p':
+            fit_policies = 1;
+            break;
+        case 'h':
+            usage();
+            exit(0);
+        default:
+            usage();
+            exit(1);
+        }
+    }
+    if (optind == argc) {
+        usage();
+        exit(1);
+    }
+
+    if (fit_policies)
+        mem_init();
+    for (i = optind; i < argc; i++) {
+        trace_t *trace = read_trace("", argv[i]);
+        profile(trace);
+        if (fit_policies)
+            fit_report(trace);
+        free_trace(trace);
+    }
+    if (fit_policies)
+        mem_deinit();
+    return 0;
+}
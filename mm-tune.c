@@ -0,0 +1,443 @@
+/*
+ * mm-tune.c - Offline search for the mm.c parameters that suit a workload
+ *
+ * The seg list boundaries (MM_CLASSES), CHUNKSIZE and the depth of the
+ * best-fit search were picked by hand for the default traces. mm-tune
+ * replays a set of traces against a build of mm.c whose parameters are
+ * variables (-DMM_TUNABLE), scores each parameter set the way mdriver
+ * computes its performance index, and hill-climbs from the current
+ * parameters: every generation re-scores the best set so far next to
+ * random mutations of it, so a lucky timing does not stick. Candidates
+ * are scored in parallel by forked workers, one per CPU, each pinned to
+ * its own CPU so they do not disturb each other's timings.
+ *
+ * The result is written as a header that mm.c picks up with
+ *     make TUNED=<header>
+ */
+#define _GNU_SOURCE
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "mm.h"
+#include "mm-internals.h"
+#include "memlib.h"
+#include "clock.h"
+#include "config.h"
+#include "trace.h"
+
+/* Defaults, see usage() */
+#define GENERATIONS 30
+#define POPULATION  8
+#define SPEED_RUNS  3       /* timed replays of each trace, best one counts */
+#define OUTFILE     "mm-tuned.h"
+#define MAXTRACES   64
+
+/* Limits of the search */
+#define MIN_BOUND     24        /* smallest block */
+#define MAX_BOUND     (1 << 20)
+#define MIN_CHUNK     64
+#define MAX_CHUNK     (1 << 16)
+#define MAX_DEPTH     64
+
+/* How one parameter set did over all traces */
+typedef struct {
+    int valid;     /* 0 if the allocator failed a request */
+    double util;   /* average utilization of the util traces */
+    double kops;   /* throughput of the perf traces, Kops/sec */
+    double score;  /* performance index, 0..100 */
+} result_t;
+
+static trace_t *traces[MAXTRACES];
+static int num_traces = 0;
+static double util_weight = UTIL_WEIGHT;
+static double Mhz;
+static int verbose = 0;
+
+static void app_error(const char *msg)
+{
+    fprintf(stderr, "%s\n", msg);
+    exit(1);
+}
+
+static void unix_error(const char *msg)
+{
+    perror(msg);
+    exit(1);
+}
+
+/*
+ * perf_index - mdriver's performance index for util and ops/sec
+ */
+static double perf_index(double util, double throughput)
+{
+    double p1, p2;
+
+    if (util < MIN_SPACE)
+        p1 = 0;
+    else if (util > MAX_SPACE)
+        p1 = util_weight;
+    else
+        p1 = (util - MIN_SPACE) / (MAX_SPACE - MIN_SPACE) * util_weight;
+
+    if (throughput < MIN_SPEED)
+        p2 = 0;
+    else if (throughput > MAX_SPEED)
+        p2 = 1.0 - util_weight;
+    else
+        p2 = (throughput - MIN_SPEED) / (MAX_SPEED - MIN_SPEED) *
+            (1.0 - util_weight);
+
+    return (p1 + p2) * 100.0;
+}
+
+/*
+ * evaluate - Score the parameters in effect over all traces
+ */
+static result_t evaluate(void)
+{
+    result_t r = { 1, 0, 0, 0 };
+    double util = 0, secs = 0, ops = 0, cyc, best;
+    int nutil = 0, i, run, fail;
+    long hwm = 0;
+
+    for (i = 0; i < num_traces; i++) {
+        trace_t *trace = traces[i];
+
+        best = 1e300;
+        for (run = 0; run < SPEED_RUNS; run++) {
+            start_counter();
+            fail = trace_replay(trace, &hwm);
+            cyc = get_counter();
+            if (fail) {
+                r.valid = 0;
+                return r;
+            }
+            if (cyc < best)
+                best = cyc;
+        }
+
+        if (trace->weight == WALL || trace->weight == WUTIL) {
+            util += (double)hwm / mem_heapsize();
+            nutil++;
+        }
+        if (trace->weight == WALL || trace->weight == WPERF) {
+            secs += best / (Mhz * 1e6);
+            ops += trace->num_ops;
+        }
+    }
+
+    r.util = nutil ? util / nutil : 0;
+    r.kops = secs > 0 ? ops / secs / 1e3 : 0;
+    r.score = perf_index(r.util, r.kops * 1e3);
+    return r;
+}
+
+/*
+ * nth_cpu - The n-th CPU we may run on, wrapping around
+ */
+static int nth_cpu(int n)
+{
+    cpu_set_t set;
+    int cpu, count;
+
+    if (sched_getaffinity(0, sizeof(set), &set) < 0 ||
+        (count = CPU_COUNT(&set)) == 0)
+        return -1;
+    n %= count;
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &set) && n-- == 0)
+            return cpu;
+    return -1;
+}
+
+/*
+ * evaluate_all - Score n candidates with up to jobs forked workers.
+ *     Worker k scores candidates k, k + jobs, ... and writes the
+ *     results back through its pipe.
+ */
+static void evaluate_all(mm_params_t *cand, result_t *res, int n, int jobs)
+{
+    int fd[jobs][2];
+    pid_t pid[jobs];
+    int k, i;
+
+    if (jobs > n)
+        jobs = n;
+
+    for (k = 0; k < jobs; k++) {
+        if (pipe(fd[k]) < 0)
+            unix_error("pipe failed");
+        if ((pid[k] = fork()) < 0)
+            unix_error("fork failed");
+        if (pid[k] == 0) {
+            close(fd[k][0]);
+            pin_cpu(nth_cpu(k), 0);
+            for (i = k; i < n; i += jobs) {
+                mm_set_params(&cand[i]);
+                res[i] = evaluate();
+                if (write(fd[k][1], &res[i], sizeof(result_t)) !=
+                    sizeof(result_t))
+                    _exit(1);
+            }
+            _exit(0);
+        }
+        close(fd[k][1]);
+    }
+
+    for (k = 0; k < jobs; k++) {
+        for (i = k; i < n; i += jobs)
+            if (read(fd[k][0], &res[i], sizeof(result_t)) != sizeof(result_t))
+                res[i].valid = 0;
+        close(fd[k][0]);
+        waitpid(pid[k], NULL, 0);
+    }
+}
+
+/* Uniform random number in [lo, hi) */
+static double uniform(double lo, double hi)
+{
+    return lo + (hi - lo) * (random() / (RAND_MAX + 1.0));
+}
+
+/* Scale x by a random factor around 1 and round to a multiple of 8 */
+static long scale8(size_t x)
+{
+    return (long)(x * exp(uniform(-0.4, 0.4)) + 4) & ~7L;
+}
+
+/*
+ * mutate - Change one or two parameters of p at random
+ */
+static void mutate(mm_params_t *p)
+{
+    int changes = 1 + random() % 2;
+    long lo, hi, x;
+    int i;
+
+    while (changes-- > 0) {
+        switch (random() % 4) {
+        case 0:
+        case 1: /* move a boundary between its neighbours */
+            i = random() % p->nbounds;
+            lo = i > 0 ? (long)p->class_max[i - 1] + 8 : MIN_BOUND;
+            hi = i < p->nbounds - 1 ? (long)p->class_max[i + 1] - 8
+                                        : MAX_BOUND;
+            if (lo > hi)
+                break;
+            x = scale8(p->class_max[i]);
+            p->class_max[i] = x < lo ? lo : x > hi ? hi : x;
+            break;
+        case 2:
+            x = scale8(p->chunksize);
+            p->chunksize = x < MIN_CHUNK ? MIN_CHUNK :
+                x > MAX_CHUNK ? MAX_CHUNK : x;
+            break;
+        case 3:
+            p->search_depth += (random() % 2 ? 1 : -1) * (1 + random() % 3);
+            if (p->search_depth < 1)
+                p->search_depth = 1;
+            if (p->search_depth > MAX_DEPTH)
+                p->search_depth = MAX_DEPTH;
+            break;
+        }
+    }
+}
+
+static void print_params(FILE *fp, const char *prefix, mm_params_t *p)
+{
+    int i;
+
+    fprintf(fp, "%sCHUNKSIZE %zu, SEARCH_DEPTH %d, classes", prefix,
+            p->chunksize, p->search_depth);
+    for (i = 0; i < p->nbounds; i++)
+        fprintf(fp, " %zu", p->class_max[i]);
+    fprintf(fp, "\n");
+}
+
+/*
+ * write_header - Write the parameters as a header for make TUNED=
+ */
+static void write_header(const char *outfile, mm_params_t *p,
+                         result_t *best, result_t *start)
+{
+    FILE *fp;
+    int i;
+
+    if ((fp = fopen(outfile, "w")) == NULL)
+        unix_error("Could not open the output file");
+
+    fprintf(fp, "/*\n * %s - mm.c parameters generated by mm-tune\n *\n",
+            outfile);
+    fprintf(fp, " * Tuned on %d traces with util weight %.2f:\n", num_traces,
+            util_weight);
+    for (i = 0; i < num_traces; i++)
+        fprintf(fp, " *     %s\n", traces[i]->filename);
+    fprintf(fp, " * Perf index %.1f (util %.1f%%, %.0f Kops), "
+            "from %.1f (util %.1f%%, %.0f Kops)\n *\n",
+            best->score, best->util * 100, best->kops,
+            start->score, start->util * 100, start->kops);
+    fprintf(fp, " * Build with: make TUNED=%s\n */\n\n", outfile);
+
+    fprintf(fp, "#define CHUNKSIZE     (%zu)\n", p->chunksize);
+    fprintf(fp, "#define SEARCH_DEPTH  %d\n\n", p->search_depth);
+    fprintf(fp, "#define MM_CLASSES(X, a)");
+    for (i = 0; i < p->nbounds; i++)
+        fprintf(fp, "%s X(%zu, a)", i % 6 ? "" : " \\\n   ",
+                p->class_max[i]);
+    fprintf(fp, "\n");
+
+    if (fclose(fp) != 0)
+        unix_error("Could not write the output file");
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mm-tune [-hv] [-f <file>]... [-t <dir>] "
+            "[-j <n>] [-n <n>] [-p <n>] [-u <w>] [-s <seed>] [-o <file>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-f <file>  Tune on this trace file (repeatable; "
+            "default: the mdriver traces).\n");
+    fprintf(stderr, "\t-t <dir>   Directory of the default traces "
+            "(default %s).\n", TRACEDIR);
+    fprintf(stderr, "\t-j <n>     Parallel workers (default: one per CPU).\n");
+    fprintf(stderr, "\t-n <n>     Generations (default %d).\n", GENERATIONS);
+    fprintf(stderr, "\t-p <n>     Candidates per generation (default %d).\n",
+            POPULATION);
+    fprintf(stderr, "\t-u <w>     Weight of utilization in the score "
+            "(default %.2f).\n", UTIL_WEIGHT);
+    fprintf(stderr, "\t-s <seed>  Random seed (default 1).\n");
+    fprintf(stderr, "\t-o <file>  Header to write (default %s).\n", OUTFILE);
+    fprintf(stderr, "\t-v         Print every candidate.\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+}
+
+int main(int argc, char **argv)
+{
+    static char *default_tracefiles[] = { DEFAULT_TRACEFILES, NULL };
+    char *tracefiles[MAXTRACES];
+    char *tracedir = TRACEDIR;
+    char *outfile = OUTFILE;
+    int ntracefiles = 0;
+    int generations = GENERATIONS, population = POPULATION;
+    int jobs = 0, gen, i, b;
+    unsigned seed = 1;
+    char c;
+
+    while ((c = getopt(argc, argv, "f:t:j:n:p:u:s:o:vh")) != EOF) {
+        switch (c) {
+        case 'f':
+            if (ntracefiles == MAXTRACES)
+                app_error("Too many trace files");
+            tracefiles[ntracefiles++] = optarg;
+            break;
+        case 't':
+            tracedir = optarg;
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        case 'n':
+            generations = atoi(optarg);
+            break;
+        case 'p':
+            population = atoi(optarg);
+            break;
+        case 'u':
+            util_weight = atof(optarg);
+            break;
+        case 's':
+            seed = atoi(optarg);
+            break;
+        case 'o':
+            outfile = optarg;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'h':
+            usage();
+            exit(0);
+        default:
+            usage();
+            exit(1);
+        }
+    }
+    if (population < 2)
+        population = 2;
+    if (util_weight < 0 || util_weight > 1)
+        app_error("The util weight must be between 0 and 1");
+    if (jobs <= 0 && (jobs = sysconf(_SC_NPROCESSORS_ONLN)) <= 0)
+        jobs = 1;
+
+    if (ntracefiles == 0)
+        for (i = 0; default_tracefiles[i]; i++)
+            tracefiles[ntracefiles++] = default_tracefiles[i];
+    else
+        tracedir = "";  /* -f names the files themselves */
+    for (i = 0; i < ntracefiles; i++)
+        traces[num_traces++] = read_trace(tracedir, tracefiles[i]);
+
+    srandom(seed);
+    pin_cpu(nth_cpu(0), 0);
+    Mhz = mhz(0);
+    mem_init();
+
+    {
+        mm_params_t cand[population];
+        result_t res[population], start, best;
+
+        mm_get_params(&cand[0]);
+        evaluate_all(cand, res, 1, 1);
+        if (!res[0].valid)
+            app_error("mm.c fails on these traces with its own parameters");
+        start = best = res[0];
+        printf("Tuning on %d traces, %d workers, %d x %d candidates\n",
+               num_traces, jobs, generations, population);
+        printf("start:  index %5.1f  util %5.1f%%  %8.0f Kops\n",
+               start.score, start.util * 100, start.kops);
+        print_params(stdout, "        ", &cand[0]);
+
+        for (gen = 1; gen <= generations; gen++) {
+            /* cand[0] is the best so far, scored again */
+            for (i = 1; i < population; i++) {
+                cand[i] = cand[0];
+                mutate(&cand[i]);
+            }
+            evaluate_all(cand, res, population, jobs);
+
+            for (b = 0, i = 1; i < population; i++) {
+                if (verbose) {
+                    printf("  %2d: index %5.1f%s\n", i, res[i].score,
+                           res[i].valid ? "" : " (failed)");
+                    print_params(stdout, "      ", &cand[i]);
+                }
+                if (res[i].valid && res[i].score > res[b].score)
+                    b = i;
+            }
+            if (b != 0) {
+                cand[0] = cand[b];
+                best = res[b];
+                printf("gen %2d: index %5.1f  util %5.1f%%  %8.0f Kops\n",
+                       gen, best.score, best.util * 100, best.kops);
+                print_params(stdout, "        ", &cand[0]);
+            } else {
+                best = res[0];
+            }
+            fflush(stdout);
+        }
+
+        write_header(outfile, &cand[0], &best, &start);
+        printf("Wrote %s: index %.1f, from %.1f\n", outfile, best.score,
+               start.score);
+    }
+
+    mem_deinit();
+    for (i = 0; i < num_traces; i++)
+        free_trace(traces[i]);
+    return 0;
+}
@@ -5,17 +5,41 @@
  * techniques:
  * 1) Data Structure: Segregated Free Lists
  * 2) Insertion policy: Last in, first out (LIFO)
- * 3) Finding method: Combination of first fit and best fit
- * 4) Coalescing is done at every call to free.
+ * 3) Finding method: Combination of first fit and best fit by default;
+ *    first, next, best and adaptive fit can be picked with FIT_POLICY
+ * 4) Coalescing is done at every call to free, except for small blocks,
+ *    which wait on quick-lists for a request of their exact size.
+ * 5) The free block at the top of the heap (the wilderness) is kept off
+ *    the seg lists, and used only when nothing on them fits.
+ * 6) On a heap backed by huge pages, blocks of a huge page or more start
+ *    on a huge page boundary.
+ * 7) memalign, posix_memalign and aligned_alloc cut an aligned block out
+ *    of a free one, and put the slack on either side back on the lists.
+ * 8) malloc_usable_size reports the slack a block has past its request,
+ *    which the caller may use; free_sized checks the size it is given.
+ * 9) malloc_batch carves many blocks of one size out of a few free
+ *    blocks; free_batch frees each run of neighbouring blocks as one.
+ * 10) mm_heap_create makes a heap of its own, in a memlib region of its
+ *    own, which mm_heap_destroy drops with all its blocks at once.
+ * 11) mm_region_alloc bumps a pointer through chunks of the heap, which
+ *    mm_region_reset gives back all at once.
+ * 12) mm_pool_alloc hands out objects of one size from slabs of the
+ *    heap, with no tags of their own, and gives empty slabs back.
  */
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <unistd.h>
 
 #include "mm.h"
 #include "memlib.h"
+#include "memops.h"
+#ifdef MM_INTERNALS
+#include "mm-internals.h"
+#endif
 
 /* If you want debugging output, use the following macro.  When you hand
  * in, remove the #define DEBUG line. */
@@ -34,34 +58,137 @@
 #define free mm_free
 #define realloc mm_realloc
 #define calloc mm_calloc
+#define memalign mm_memalign
+#define posix_memalign mm_posix_memalign
+#define aligned_alloc mm_aligned_alloc
+#define free_sized mm_free_sized
+#define malloc_usable_size mm_malloc_usable_size
+#define malloc_batch mm_malloc_batch
+#define free_batch mm_free_batch
 #endif /* def DRIVER */
 
+/* Parameters tuned for a workload by mm-tune, if any (make TUNED=<header>).
+ * It may define any of CHUNKSIZE, SEARCH_DEPTH, FIT_POLICY and the size
+ * classes (MM_CLASSES, or MM_CLASS_COUNT and friends; see below). */
+#ifdef MM_TUNED_HEADER
+#include MM_TUNED_HEADER
+#endif
+
 /* Basic constants and macros */
-#define WSIZE 4 /* Word and header/footer size (bytes) */
+#define WSIZE 4 /* Word size (bytes), what extend_heap counts in */
 #define DSIZE 8 /* Double word size (bytes) */
+#ifndef CHUNKSIZE
 #define CHUNKSIZE  (672)  /* initial heap size (bytes) 128=88%, 672=512=256=91%, 848=1024=90%*/
+#endif
+/*
+ * Heap growth. When the heap must grow it grows by at least the growth
+ * size, which starts at CHUNKSIZE. If the heap grew again within
+ * GROW_BURST mallocs the growth size doubles, up to GROW_MAX and to
+ * 1/GROW_SHARE of the heap, so allocation-heavy phases extend the heap
+ * rarely while small heaps keep the small chunks CHUNKSIZE was tuned
+ * for. After GROW_STEADY mallocs without growth it halves back towards
+ * CHUNKSIZE.
+ */
+#ifndef GROW_BURST
+#define GROW_BURST   32
+#endif
+#ifndef GROW_STEADY
+#define GROW_STEADY  1024
+#endif
+#ifndef GROW_MAX
+#define GROW_MAX     (1 << 20)
+#endif
+#ifndef GROW_SHARE
+#define GROW_SHARE   128
+#endif
+/* Number of fitting blocks find() looks at before settling for the best */
+#ifndef SEARCH_DEPTH
+#define SEARCH_DEPTH 9
+#endif
+
+/*
+ * Fit policies, i.e. which free block find() returns from a seg list:
+ *  FIT_FIRST     the first one that fits
+ *  FIT_NEXT      the first one that fits after where the last search in
+ *                the list stopped (a rover per list)
+ *  FIT_BEST      the smallest one that fits, looking through the whole list
+ *  FIT_GOOD      the smallest of the first SEARCH_DEPTH that fit
+ *  FIT_ADAPTIVE  FIT_GOOD, with the depth doubled while the blocks found
+ *                waste too much and halved while they fit closely
+ * Pick one with make MMFLAGS=-DFIT_POLICY=FIT_BEST.
+ */
+#define FIT_FIRST    0
+#define FIT_NEXT     1
+#define FIT_BEST     2
+#define FIT_GOOD     3
+#define FIT_ADAPTIVE 4
+#ifndef FIT_POLICY
+#define FIT_POLICY FIT_GOOD
+#endif
+
+/* The adaptive depth is reconsidered every ADAPT_PERIOD searches. It
+   doubles if the blocks found wasted more than 1/ADAPT_WASTE_HI of the
+   requested bytes and some search was cut short by the depth, and halves
+   if they wasted less than 1/ADAPT_WASTE_LO. */
+#define ADAPT_PERIOD    64
+#define ADAPT_WASTE_HI  8
+#define ADAPT_WASTE_LO  64
+#define ADAPT_MAX_DEPTH 256
+/*
+ * Boundary tags. By default a header or footer is 4 bytes holding the
+ * block size in 4-byte units, with the allocated bit in bit 0, so a
+ * block can be up to 16 GB. With MM_WIDE_TAGS it is 8 bytes holding the
+ * size in bytes, for blocks of any size at 8 more bytes per block.
+ */
+#ifdef MM_WIDE_TAGS
+#define H_SIZE 8 //Header size
+#define F_SIZE 8 //Footer size
+typedef unsigned long tag_t;
+#define PACK(size, alloc) ((tag_t)(size) | (alloc))
+#define TAG_SIZE(tag) ((size_t)(tag) & ~(size_t)0x7)
+#define MAX_BLOCK (~(size_t)0 & ~(size_t)0x7)
+#else
 #define H_SIZE 4 //Header size
 #define F_SIZE 4 //Footer size
+typedef unsigned int tag_t;
+#define PACK(size, alloc) ((tag_t)((size) >> 2) | (alloc))
+#define TAG_SIZE(tag) ((size_t)((tag) & ~0x1) << 2)
+#define MAX_BLOCK (((size_t)UINT_MAX & ~(size_t)0x1) << 2)
+#endif
 #define FREE_PTR_SIZE 8 //Pointer size
  /* Overhead of each free block: header + footer + free list pointers */
 #define OVERHEAD ((H_SIZE) + (F_SIZE) + (FREE_PTR_SIZE) + (FREE_PTR_SIZE)) 
 #define ALLOC_OVERHEAD ((H_SIZE) + (F_SIZE)) //overhead of allocated block
+/* Smallest block: room for a free block, in whole ALIGNMENT units */
+#define MIN_BLOCK ALIGN(OVERHEAD)
+/* The prologue is an allocated block of just a header and footer, padded
+   so that the first real block's payload is aligned */
+#define PROLOGUE ((H_SIZE) + (F_SIZE))
+#define PROLOGUE_PAD ((ALIGNMENT - (PROLOGUE + H_SIZE) % ALIGNMENT) % ALIGNMENT)
+/* Largest request whose block the tags can describe */
+#define MAX_PAYLOAD (MAX_BLOCK - ALLOC_OVERHEAD - ALIGNMENT)
 
 #define MAX(x, y) ((x) > (y) ? (x) : (y)) 
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
 
-/* Double word (8) alignment */
+/* Double word (8) alignment, or MM_ALIGNMENT for wider types: 16 for
+   the x86-64 max_align_t, 32 or 64 for vectors and cache lines. Block
+   sizes are multiples of it, and the prologue is padded to it. */
+#ifdef MM_ALIGNMENT
+#define ALIGNMENT MM_ALIGNMENT
+#else
 #define ALIGNMENT 8
+#endif
+_Static_assert(ALIGNMENT >= 8 && ALIGNMENT <= 64 &&
+               (ALIGNMENT & (ALIGNMENT - 1)) == 0,
+               "MM_ALIGNMENT must be 8, 16, 32 or 64");
 
 /* rounds up to the nearest multiple of ALIGNMENT */
-#define ALIGN(p) (((size_t)(p) + (ALIGNMENT-1)) & ~0x7)
+#define ALIGN(p) (((size_t)(p) + (ALIGNMENT-1)) & ~(size_t)(ALIGNMENT-1))
 
-/* Pack a size and allocated bit into a word */
-#define PACK(size, alloc) ((size) | (alloc))
-
-/* Read and write a word at address p */
-#define GET4(p) (*(unsigned int *)(p))
-#define PUT4(p, val) (*((unsigned int *)(p)) = (val))
+/* Read and write a boundary tag at address p */
+#define GET_TAG(p) (*(tag_t *)(p))
+#define PUT_TAG(p, val) (*(tag_t *)(p) = (val))
 /* Read and write a double word at address p */
 #define GET(p) (*(unsigned long int *)(p))
 #define PUT(p, val) (*((unsigned long int *)(p)) = (val))
@@ -69,16 +196,17 @@
 #define PUTP(p, val) (*((unsigned long int *)(p)) = (unsigned long int)(val))
 
 /* Read the size and allocated fields from address p */
-#define GET_SIZE(p) (GET4(p) & ~0x7)
-#define GET_ALLOC(p) (GET4(p) & 0x1)
+#define GET_SIZE(p) TAG_SIZE(GET_TAG(p))
+#define GET_ALLOC(p) (GET_TAG(p) & 0x1)
 
 /* Given block ptr bp, compute address of its header and footer */
-#define HDRP(bp) ((void *)(bp) - WSIZE)
-#define FTRP(bp) ((void *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
+#define HDRP(bp) ((void *)(bp) - H_SIZE)
+#define FTRP(bp) ((void *)(bp) + GET_SIZE(HDRP(bp)) - H_SIZE - F_SIZE)
 
 /* Given block ptr bp, compute address of next and previous blocks */
-#define NEXT_BLKP(bp) ((void *)(bp) + GET_SIZE(((void *)(bp) - WSIZE)))
-#define PREV_BLKP(bp) ((void *)(bp) - GET_SIZE(((void *)(bp) - DSIZE)))
+#define NEXT_BLKP(bp) ((void *)(bp) + GET_SIZE(((void *)(bp) - H_SIZE)))
+#define PREV_BLKP(bp) ((void *)(bp) - \
+    GET_SIZE(((void *)(bp) - H_SIZE - F_SIZE)))
 
 /* Given a block pointer, compute the pointer 
 to the address of the next free block*/
@@ -89,49 +217,313 @@ to the address of the next free block*/
 address of the free block.*/
 #define GET_FREE(p) (void *)(*(unsigned long int *)(p))
 
-//Offsets of the start of each linked list from seg_start.
-#define SEG1     0
-#define SEG2     8
-#define SEG3     16
-#define SEG4     24
-#define SEG5     32
-#define SEG6     40
-#define SEG7     48
-#define SEG8     56
-#define SEG9     64
-#define SEG10    72
-#define SEG11    80
-#define SEG12    88
-#define SEG13    96
-#define SEG14    104
-
-/* Max size of free blocks in each list */
-#define MAX1      24
-#define MAX2      48
-#define MAX3      72
-#define MAX4      96
-#define MAX5      120
-#define MAX6      480
-#define MAX7      960
-#define MAX8      1920
-#define MAX9      3840
-#define MAX10     7680
-#define MAX11     15360
-#define MAX12     30720
-#define MAX13     61440
-//NOTE: seglist 14 has no upper limit. 
-#define NUM_SEGS    14 //Number of seg lists
-
-/* Global variables and Constants */
-/* Pointer to the first block */
-static void *heap_listp; 
-static void *seg_start;
+/*
+ * Size classes. Seg list i holds the free blocks of up to class_max[i]
+ * bytes; the last list holds everything larger. The classes are given
+ * in one of two ways:
+ *  - MM_CLASSES(X, a), which expands X(max, a) for the upper bound of
+ *    every list but the last, in increasing order. This is the default
+ *    below, and what mm-tune writes.
+ *  - MM_CLASS_COUNT lists whose bounds grow from MM_CLASS_FIRST by a
+ *    factor of MM_CLASS_RATIO, rounded up to a multiple of 8, e.g.
+ *    make MMFLAGS=-DMM_CLASS_COUNT=32
+ *    An MM_CLASSES list takes precedence.
+ * The number of lists, class_max[] and the size to class table are all
+ * generated from this at compile time.
+ */
+#define MAX_SEGS 64
+#define CLASS_OPEN (~(size_t)0 >> 1) /* bound larger than any block */
+
+/* Repeat M(k, X, a) for k = base .. base + 63 */
+#define CREP8(M, k, X, a) M((k)+0, X, a) M((k)+1, X, a) M((k)+2, X, a) \
+    M((k)+3, X, a) M((k)+4, X, a) M((k)+5, X, a) M((k)+6, X, a) M((k)+7, X, a)
+#define CREP64(M, k, X, a) CREP8(M, (k)+0, X, a) CREP8(M, (k)+8, X, a) \
+    CREP8(M, (k)+16, X, a) CREP8(M, (k)+24, X, a) CREP8(M, (k)+32, X, a) \
+    CREP8(M, (k)+40, X, a) CREP8(M, (k)+48, X, a) CREP8(M, (k)+56, X, a)
+
+#if defined(MM_CLASS_COUNT) && !defined(MM_CLASSES)
+#if MM_CLASS_COUNT < 2 || MM_CLASS_COUNT > MAX_SEGS
+#error "MM_CLASS_COUNT must be between 2 and 64"
+#endif
+#ifndef MM_CLASS_FIRST
+#define MM_CLASS_FIRST 24
+#endif
+#ifndef MM_CLASS_RATIO
+#define MM_CLASS_RATIO 2.0
+#endif
+#define NUM_SEGS MM_CLASS_COUNT
+/* MM_CLASS_RATIO to the power k < 64, as a constant expression */
+#define RATIO_1  ((double)(MM_CLASS_RATIO))
+#define RATIO_2  (RATIO_1 * RATIO_1)
+#define RATIO_4  (RATIO_2 * RATIO_2)
+#define RATIO_8  (RATIO_4 * RATIO_4)
+#define RATIO_16 (RATIO_8 * RATIO_8)
+#define RATIO_32 (RATIO_16 * RATIO_16)
+#define RATIO_POW(k) (((k) & 1 ? RATIO_1 : 1.0) * ((k) & 2 ? RATIO_2 : 1.0) * \
+    ((k) & 4 ? RATIO_4 : 1.0) * ((k) & 8 ? RATIO_8 : 1.0) * \
+    ((k) & 16 ? RATIO_16 : 1.0) * ((k) & 32 ? RATIO_32 : 1.0))
+/* Bounds past the last bounded list are open, and match no size */
+#define GEO_BOUND(k) ((k) < NUM_SEGS - 1 ? \
+    ((size_t)(MM_CLASS_FIRST * RATIO_POW(k)) + 7) & ~(size_t)7 : CLASS_OPEN)
+#define GEO_CLASS(k, X, a) X(GEO_BOUND(k), a)
+#define MM_CLASSES(X, a) CREP64(GEO_CLASS, 0, X, a)
+#else
+#ifndef MM_CLASSES
+#define MM_CLASSES(X, a) \
+    X(24, a) X(48, a) X(72, a) X(96, a) X(120, a) X(480, a) X(960, a) \
+    X(1920, a) X(3840, a) X(7680, a) X(15360, a) X(30720, a) X(61440, a)
+#endif
+#define CLASS_ONE(max, a) + 1
+#define NUM_SEGS (1 MM_CLASSES(CLASS_ONE, ~)) //Number of seg lists
+#endif /* MM_CLASS_COUNT */
+
+/* Seg list of a block of s bytes, as a constant expression */
+#define CLASS_GT(max, s) + ((s) > (size_t)(max))
+#define CLASS_OF(s) (0 MM_CLASSES(CLASS_GT, s))
+
+/* Address of the root of seg list i */
+#define SEG_ROOT(i) (heap->seg_start + (i) * FREE_PTR_SIZE)
+
+/*
+ * Quick-lists. A freed block of up to QUICK_MAX bytes is not coalesced:
+ * it stays marked allocated in its tags and goes on a LIFO list of
+ * blocks of its exact size, linked through its first payload word, so
+ * a malloc of the same size just pops it. consolidate() frees them all
+ * for real when a request finds no fit or more than QUICK_LIMIT blocks
+ * are waiting. QUICK_MAX 0 turns quick-lists off. The list roots follow
+ * the seg list roots, one per multiple of ALIGNMENT.
+ */
+#ifndef QUICK_MAX
+#define QUICK_MAX   64
+#endif
+#ifndef QUICK_LIMIT
+#define QUICK_LIMIT 128
+#endif
+#define QUICK_LISTS (QUICK_MAX / ALIGNMENT + 1)
+#define IS_QUICK(size) ((size) / ALIGNMENT < QUICK_LISTS)
+#define QUICK_ROOT(size) SEG_ROOT(NUM_SEGS + (size) / ALIGNMENT)
+
+/*
+ * Regions. mm_region_alloc bumps a pointer through chunks the region
+ * mallocs, REGION_CHUNK bytes at first and twice as much each time one
+ * fills, up to REGION_CHUNK_MAX. A request of more than a quarter of
+ * the next chunk size gets a chunk of its own, behind the current one,
+ * so the rest of that is not thrown away. Each chunk links to the one
+ * before in its first word.
+ */
+#ifndef REGION_CHUNK
+#define REGION_CHUNK     (4 << 10)
+#endif
+#ifndef REGION_CHUNK_MAX
+#define REGION_CHUNK_MAX (1 << 20)
+#endif
+#define REGION_HDR ALIGN(sizeof(void *))
+#define REGION_BATCH 64  /* chunks given to each free_batch */
+
+/*
+ * Pools. A pool carves objects of one size out of slabs, each a block
+ * of a power of two bytes (POOL_SLAB or more, enough for POOL_MIN_OBJS
+ * objects) aligned to its size, less the tags, so that slabs from the
+ * wilderness follow one another without a gap and an object finds its
+ * slab by masking its address: it needs no header of its own. A free
+ * object is linked through its first word. One empty slab is kept for
+ * the next alloc; any more go back to the heap.
+ */
+#ifndef POOL_SLAB
+#define POOL_SLAB     (16 << 10)
+#endif
+#define POOL_MIN_OBJS 8
+
+/*
+ * Size summaries. Following a seg list costs a cache miss or two per
+ * block, for its header and its next pointer, scattered over the heap.
+ * With SUMMARY_LEN > 0, the first SUMMARY_LEN blocks of each list are
+ * mirrored, in list order, by a packed array of their header tags next
+ * to one of their addresses: find() compares all the sizes at once, in
+ * a cache line or two, and touches a block only once it picks it. The
+ * rest of a longer list is followed as before, a block ahead.
+ * The summaries are a few more cache lines per list to keep up on every
+ * insert and splice, which the driver's short traces, timed from a cold
+ * cache, do not win back; they are off unless built in, e.g.
+ *    make MMFLAGS=-DSUMMARY_LEN=16
+ */
+#ifndef SUMMARY_LEN
+#define SUMMARY_LEN 0
+#endif
+#if SUMMARY_LEN < 0 || SUMMARY_LEN > 32
+#error "SUMMARY_LEN must be 0 to 32"
+#endif
+
+/* Block sizes up to CLASS_TABLE_MAX find their list with one lookup */
+#define CLASS_TABLE_LEN 512
+#define CLASS_TABLE_MAX (CLASS_TABLE_LEN * ALIGNMENT)
+#define TREP8(M, k) M((k)+0) M((k)+1) M((k)+2) M((k)+3) \
+    M((k)+4) M((k)+5) M((k)+6) M((k)+7)
+#define TREP64(M, k) TREP8(M, (k)+0) TREP8(M, (k)+8) TREP8(M, (k)+16) \
+    TREP8(M, (k)+24) TREP8(M, (k)+32) TREP8(M, (k)+40) TREP8(M, (k)+48) \
+    TREP8(M, (k)+56)
+#define TREP512(M, k) TREP64(M, (k)+0) TREP64(M, (k)+64) TREP64(M, (k)+128) \
+    TREP64(M, (k)+192) TREP64(M, (k)+256) TREP64(M, (k)+320) \
+    TREP64(M, (k)+384) TREP64(M, (k)+448)
+#define CLASS_TABLE_ENTRY(k) CLASS_OF((size_t)(k) * ALIGNMENT),
+#define CLASS_BOUND(max, a) \
+    ((size_t)(max) == CLASS_OPEN ? (size_t)-1 : (size_t)(max)),
+
+#ifdef MM_TUNABLE
+/* In the tuner's build the parameters are variables; see mm_set_params() */
+#define CLASS_CONST
+static size_t tune_chunksize = CHUNKSIZE;
+static int tune_search_depth = SEARCH_DEPTH;
+#undef CHUNKSIZE
+#undef SEARCH_DEPTH
+#define CHUNKSIZE (tune_chunksize)
+#define SEARCH_DEPTH (tune_search_depth)
+#else
+#define CLASS_CONST const
+#endif /* def MM_TUNABLE */
+
+/* Upper bound of each seg list; the last one is open */
+static CLASS_CONST size_t class_max[] = {
+    MM_CLASSES(CLASS_BOUND, ~) (size_t)-1
+};
+/* Seg list of each block size up to CLASS_TABLE_MAX, by size/ALIGNMENT */
+static CLASS_CONST unsigned char class_table[CLASS_TABLE_LEN + 1] = {
+    0, TREP512(CLASS_TABLE_ENTRY, 1)
+};
+_Static_assert(NUM_SEGS <= MAX_SEGS, "too many size classes");
+
+#ifdef MM_INTERNALS
+/* The tools switch policies at run time, and count what searches do */
+#define FIT_CONST
+#define FIT_STAT(x) (x)
+static mm_fit_stats_t fit_stats;
+#else
+#define FIT_CONST const
+#define FIT_STAT(x)
+#endif
+static FIT_CONST int fit_policy = FIT_POLICY;
+
+#if SUMMARY_LEN > 0
+/* The first blocks of a seg list, see SUMMARY_LEN */
+typedef struct {
+    tag_t tag[SUMMARY_LEN]; /* their headers */
+    void *bp[SUMMARY_LEN];
+} summary_t;
+#endif
+
+/*
+ * A heap: its blocks, and the lists and counters that manage them.
+ * malloc and friends work on main_heap; a heap of mm_heap_create keeps
+ * this at the start of its own memlib region. heap is the one that the
+ * functions below work on, see heap_enter.
+ */
+struct mm_heap {
+    mem_t *mem;          /* its memlib region; NULL for main_heap */
+    /* Pointer to the first block */
+    void *heap_listp;
+    void *seg_start;
+    int quick_count;     /* blocks waiting on the quick-lists */
+    size_t grow_size;    /* least the heap grows by, see GROW_BURST */
+    long grow_mallocs;   /* mallocs since the heap last grew */
+    /* The free block just before the epilogue, if any. It is on no seg
+       list: the heap grows into it, and only requests nothing else fits
+       take from it, so its space stays in one piece at the top. */
+    void *wilderness;
+    /* Huge page size if the heap is backed by huge pages, else 0 */
+    size_t huge_page;
+    /* Every byte of the heap from zero_start on is zero, but for boundary
+       tags and the wilderness's (null) list pointers: memory fresh from
+       mem_sbrk is zero, and only place() hands it out. calloc clears
+       only what lies below. */
+    void *zero_start;
+    /* FIT_NEXT: where the next search of each seg list starts */
+    void *rover[MAX_SEGS];
+#if SUMMARY_LEN > 0
+    /* The first blocks of each seg list, see SUMMARY_LEN */
+    summary_t summary[NUM_SEGS];
+    /* MIN(SUMMARY_LEN, blocks on the list) */
+    int summary_len[NUM_SEGS];
+#endif
+    /* FIT_ADAPTIVE: current depth, and what the searches of this period
+       did */
+    int adapt_depth;
+    int adapt_searches;
+    int adapt_cut;
+    size_t adapt_waste;
+    size_t adapt_asize;
+};
+
+static struct mm_heap main_heap;
+static struct mm_heap *heap = &main_heap;
+
+/*
+ * class_of - Seg list for a free block of asize bytes
+ */
+static inline int class_of(size_t asize)
+{
+    int i;
+    if (asize <= CLASS_TABLE_MAX)
+        return class_table[asize / ALIGNMENT];
+    for (i = class_table[CLASS_TABLE_LEN]; asize > class_max[i]; i++)
+        ;
+    return i;
+}
 
 
 /*
  * Internal Helper Functions.
  */
 
+#if SUMMARY_LEN > 0
+/*
+ * summary_insert - Put the free block bp of size bytes in front of the
+ * summary of seg list i, as it goes in front of the list
+ */
+static inline void summary_insert(int i, void *bp, size_t size)
+{
+    summary_t *s = &heap->summary[i];
+
+    memmove(s->tag + 1, s->tag, (SUMMARY_LEN - 1) * sizeof(tag_t));
+    memmove(s->bp + 1, s->bp, (SUMMARY_LEN - 1) * sizeof(void *));
+    s->tag[0] = PACK(size, 0);
+    s->bp[0] = bp;
+    heap->summary_len[i] += (heap->summary_len[i] < SUMMARY_LEN);
+}
+
+/*
+ * summary_remove - Drop bp, just spliced out of seg list i (from its
+ * front if first), from its summary if it is there, and let the block
+ * that now follows the summarized ones take its place
+ */
+static inline void summary_remove(int i, void *bp, int first)
+{
+    summary_t *s = &heap->summary[i];
+    void *next;
+    int k = 0;
+
+    if (!first) {
+        for (k = 1; k < heap->summary_len[i] && s->bp[k] != bp; k++)
+            ;
+        if (k == heap->summary_len[i])
+            return;
+    }
+    heap->summary_len[i]--;
+    memmove(s->tag + k, s->tag + k + 1, (SUMMARY_LEN - 1 - k) * sizeof(tag_t));
+    memmove(s->bp + k, s->bp + k + 1, (SUMMARY_LEN - 1 - k) * sizeof(void *));
+    if ((k = heap->summary_len[i]) == SUMMARY_LEN - 1) {
+        next = k ? GET_FREE(NEXT_FREE(s->bp[k - 1])) : GET_FREE(SEG_ROOT(i));
+        if (next != NULL) {
+            s->tag[k] = GET_TAG(HDRP(next));
+            s->bp[k] = next;
+            heap->summary_len[i]++;
+        }
+    }
+}
+#else
+#define summary_insert(i, bp, size)
+#define summary_remove(i, bp, first)
+#endif /* SUMMARY_LEN > 0 */
+
 /*
  * Given a pointer to a free block in the free list, splice the block
  * from the free list and return a pointer to that block.
@@ -140,24 +532,20 @@ static void *splice_block(void *bp) {
     /* Get prev and next free blocks of the free list. */
     void *prev_free = GET_FREE(PREV_FREE(bp));
     void *succ_free = GET_FREE(NEXT_FREE(bp));
-    size_t size = GET_SIZE(HDRP(bp));
+    int i;
+    /* The wilderness is on no list */
+    if (bp == heap->wilderness) {
+        heap->wilderness = NULL;
+        return bp;
+    }
+    i = class_of(GET_SIZE(HDRP(bp)));
+    /* Move a next-fit rover off the block */
+    if (fit_policy == FIT_NEXT && heap->rover[i] == bp)
+        heap->rover[i] = succ_free;
     /* Case 1: bp is the first block in the free list of more than 1 element.
     make the seg list header point to the next free block.*/
     if ((prev_free == NULL) && (succ_free != NULL)) {
-        if (size <= MAX1) PUTP(seg_start + SEG1, succ_free);
-        else if (size <= MAX2) PUTP(seg_start + SEG2, succ_free);
-        else if (size <= MAX3) PUTP(seg_start + SEG3, succ_free);
-        else if (size <= MAX4) PUTP(seg_start + SEG4, succ_free);
-        else if (size <= MAX5) PUTP(seg_start + SEG5, succ_free);
-        else if (size <= MAX6) PUTP(seg_start + SEG6, succ_free);
-        else if (size <= MAX7) PUTP(seg_start + SEG7, succ_free);
-        else if (size <= MAX8) PUTP(seg_start + SEG8, succ_free);
-        else if (size <= MAX9) PUTP(seg_start + SEG9, succ_free);
-        else if (size <= MAX10) PUTP(seg_start + SEG10, succ_free);
-        else if (size <= MAX11) PUTP(seg_start + SEG11, succ_free);
-        else if (size <= MAX12) PUTP(seg_start + SEG12, succ_free);
-        else if (size <= MAX13) PUTP(seg_start + SEG13, succ_free);
-        else PUTP(seg_start + SEG14, succ_free);
+        PUTP(SEG_ROOT(i), succ_free);
 
         /* Update the new front's prev pointer to null. */
         PUTP(PREV_FREE(succ_free), 0);
@@ -170,20 +558,7 @@ static void *splice_block(void *bp) {
     /* Case 3: bp is the only block in the free list. Make the free list header
     point to NULL. */
     else if ((prev_free == NULL) && (succ_free == NULL)) {
-        if (size <= MAX1) PUTP(seg_start + SEG1, 0);
-        else if (size <= MAX2) PUTP(seg_start + SEG2, 0);
-        else if (size <= MAX3) PUTP(seg_start + SEG3, 0);
-        else if (size <= MAX4) PUTP(seg_start + SEG4, 0);
-        else if (size <= MAX5) PUTP(seg_start + SEG5, 0);
-        else if (size <= MAX6) PUTP(seg_start + SEG6, 0);
-        else if (size <= MAX7) PUTP(seg_start + SEG7, 0);
-        else if (size <= MAX8) PUTP(seg_start + SEG8, 0);
-        else if (size <= MAX9) PUTP(seg_start + SEG9, 0);
-        else if (size <= MAX10) PUTP(seg_start + SEG10, 0);
-        else if (size <= MAX11) PUTP(seg_start + SEG11, 0);
-        else if (size <= MAX12) PUTP(seg_start + SEG12, 0);
-        else if (size <= MAX13) PUTP(seg_start + SEG13, 0);
-        else PUTP(seg_start + SEG14, 0);
+        PUTP(SEG_ROOT(i), 0);
     }
     /* Case 4: bp is somewhere in the middle of a free list
     with more than 2 elements. update next and prev pointers. */
@@ -191,6 +566,7 @@ static void *splice_block(void *bp) {
         PUTP(NEXT_FREE(prev_free), succ_free);
         PUTP(PREV_FREE(succ_free), prev_free);
     }
+    summary_remove(i, bp, prev_free == NULL);
     return bp;
 }
 
@@ -219,8 +595,8 @@ static void *coalesce(void *bp)
         splice_block(NEXT_BLKP(bp));
         /* Fix header and footer, i.e. coalesce current and next blocks.*/
         size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
-        PUT4(HDRP(bp), PACK(size, 0));
-        PUT4(FTRP(bp), PACK(size, 0));
+        PUT_TAG(HDRP(bp), PACK(size, 0));
+        PUT_TAG(FTRP(bp), PACK(size, 0));
         return(bp);
     }
     /* Case 3: Next block is allocated but the prev block is free.
@@ -231,8 +607,8 @@ static void *coalesce(void *bp)
         ptr = splice_block(PREV_BLKP(bp));
         /* Fix header and footer, i.e. coalesce current and prev blocks.*/
         size += GET_SIZE(HDRP(PREV_BLKP(bp)));
-        PUT4(FTRP(bp), PACK(size, 0));
-        PUT4(HDRP(PREV_BLKP(bp)), PACK(size, 0));
+        PUT_TAG(FTRP(bp), PACK(size, 0));
+        PUT_TAG(HDRP(PREV_BLKP(bp)), PACK(size, 0));
         return ptr;
     }
 
@@ -247,8 +623,8 @@ static void *coalesce(void *bp)
         /* Fix header and footer, i.e. coalesce blocks.*/
         size += GET_SIZE(HDRP(PREV_BLKP(bp))) + 
             GET_SIZE(FTRP(NEXT_BLKP(bp)));
-        PUT4(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-        PUT4(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
+        PUT_TAG(HDRP(PREV_BLKP(bp)), PACK(size, 0));
+        PUT_TAG(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
         return ptr;
     }
 }
@@ -277,62 +653,18 @@ static void *flist_insert(void *bp) {
     size_t size = GET_SIZE(HDRP(bp));
     void *flist_root; //address of seg list pointer.
     void *root_loc; //address of address of seg list pointer.
-    if (size <= MAX1) {
-        root_loc = seg_start + SEG1;
-        flist_root = (void *)GET(root_loc);
-    }
-    else if (size <= MAX2) {
-        root_loc = seg_start + SEG2;
-        flist_root = (void *)GET(root_loc);
-    }
-    else if (size <= MAX3) {
-        root_loc = seg_start + SEG3;
-        flist_root = (void *)GET(root_loc);
-    }
-    else if (size <= MAX4) {
-        root_loc = seg_start + SEG4;
-        flist_root = (void *)GET(root_loc);
-    }
-    else if (size <= MAX5) {
-        root_loc = seg_start + SEG5;
-        flist_root = (void *)GET(root_loc);
-    }
-    else if (size <= MAX6) {
-        root_loc = seg_start + SEG6;
-        flist_root = (void *)GET(root_loc);
-    }
-    else if (size <= MAX7) {
-        root_loc = seg_start + SEG7;
-        flist_root = (void *)GET(root_loc);
-    }
-    else if (size <= MAX8) {
-        root_loc = seg_start + SEG8;
-        flist_root = (void *)GET(root_loc);
-    }
-    else if (size <= MAX9) {
-        root_loc = seg_start + SEG9;
-        flist_root = (void *)GET(root_loc);
-    }
-    else if (size <= MAX10) {
-        root_loc = seg_start + SEG10;
-        flist_root = (void *)GET(root_loc);
-    }
-    else if (size <= MAX11) {
-        root_loc = seg_start + SEG11;
-        flist_root = (void *)GET(root_loc);
-    }
-    else if (size <= MAX12) {
-        root_loc = seg_start + SEG12;
-        flist_root = (void *)GET(root_loc);
-    }
-    else if (size <= MAX13) {
-        root_loc = seg_start + SEG13;
-        flist_root = (void *)GET(root_loc);
-    }
-    else {
-        root_loc = seg_start + SEG14;
-        flist_root = (void *)GET(root_loc);
+    int i;
+    //A block that ends at the epilogue becomes the wilderness instead.
+    if (GET_SIZE(HDRP(NEXT_BLKP(bp))) == 0) {
+        PUTP(PREV_FREE(bp), 0);
+        PUTP(NEXT_FREE(bp), 0);
+        heap->wilderness = bp;
+        return bp;
     }
+    i = class_of(size);
+    root_loc = SEG_ROOT(i);
+    flist_root = (void *)GET(root_loc);
+    summary_insert(i, bp, size);
     //Now that we have the correct, flist_root and root_loc, 
     //call seglist_insert.
     return seglist_insert(bp, flist_root, root_loc);
@@ -343,28 +675,83 @@ static void *flist_insert(void *bp) {
  */
 static void *extend_heap(size_t words) 
 {
-    void *bp;
+    void *bp, *ptr;
     size_t size;
     
-    /* Allocate an even number of words to maintain alignment */
-    size = (words % 2) ? (words+1) * WSIZE : words * WSIZE;
+    /* Allocate whole ALIGNMENT units to maintain alignment */
+    size = ALIGN(words * WSIZE);
     if ((long)(bp = mem_sbrk(size)) < 0) 
         return NULL;
 
     /* Initialize free block header/footer and the epilogue header */
-    PUT4(HDRP(bp), PACK(size, 0)); /* free block header, which 
+    PUT_TAG(HDRP(bp), PACK(size, 0)); /* free block header, which 
     was the old epilogue header */
-    PUT4(FTRP(bp), PACK(size, 0)); /* free block footer */
-    PUT4(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* new epilogue header */
-
-    /* Coalesce if the previous block was free, and insert in the seg
-    list. */
-    return flist_insert(coalesce(bp));
+    PUT_TAG(FTRP(bp), PACK(size, 0)); /* free block footer */
+    PUT_TAG(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* new epilogue header */
+
+    /* Coalesce if the previous block was free. The result ends at the
+    epilogue, so it becomes the wilderness. Merged into the wilderness,
+    the old footer and epilogue are no longer tags, so keep them zero. */
+    if ((ptr = coalesce(bp)) != bp && HDRP(bp) - F_SIZE >= heap->zero_start) {
+        PUT_TAG(HDRP(bp) - F_SIZE, 0);
+        PUT_TAG(HDRP(bp), 0);
+    }
+    return flist_insert(ptr);
 }
 
 
 
 
+/*
+ * consolidate - Free every block waiting on the quick-lists for real:
+ * coalesce it and insert it in its seg list.
+ */
+static void consolidate(void)
+{
+    void *bp;
+    size_t size;
+
+    for (int i = MIN_BLOCK / ALIGNMENT; i < QUICK_LISTS; i++) {
+        size = i * ALIGNMENT;
+        while ((bp = GET_FREE(QUICK_ROOT(size))) != NULL) {
+            PUTP(QUICK_ROOT(size), GET_FREE(bp));
+            PUT_TAG(HDRP(bp), PACK(size, 0));
+            PUT_TAG(FTRP(bp), PACK(size, 0));
+            flist_insert(coalesce(bp));
+        }
+    }
+    heap->quick_count = 0;
+}
+
+/*
+ * growth - How much the heap grows by at least, now that it has to grow
+ */
+static size_t growth(void)
+{
+    size_t cap;
+
+    if (heap->grow_mallocs < GROW_BURST) {
+        cap = MIN(GROW_MAX, mem_heapsize() / GROW_SHARE) &
+            ~(size_t)(ALIGNMENT-1);
+        heap->grow_size = MAX(MIN(2 * heap->grow_size, cap), heap->grow_size);
+    } else if (heap->grow_mallocs > GROW_STEADY) {
+        heap->grow_size = MAX(heap->grow_size / 2, (size_t)CHUNKSIZE);
+    }
+    heap->grow_mallocs = 0;
+    return heap->grow_size;
+}
+
+/* 
+ * adjust_size - Block size for a request of size bytes: the payload plus
+ * header and footer, rounded up to ALIGNMENT, and never smaller than a
+ * free block.
+ */
+static size_t adjust_size(size_t size)
+{
+    return MAX(MIN_BLOCK, ALIGNMENT * ((size + (ALLOC_OVERHEAD) + 
+        (ALIGNMENT-1)) / ALIGNMENT));
+}
+
 /* 
  * place - Place block of asize bytes at start of free block bp 
  *         and split if remainder would be at least minimum block size
@@ -373,103 +760,168 @@ static void place(void *bp, size_t asize)
 {
     size_t csize = GET_SIZE(HDRP(bp));   
     splice_block(bp); //remove block from seg list
+    //The block's payload is the caller's now, zero or not: all of csize
+    //if it is not split, as malloc_usable_size hands out the slack too.
+    if ((csize - asize) < (MIN_BLOCK))
+        asize = csize;
+    if (bp + asize > heap->zero_start)
+        heap->zero_start = bp + asize;
     //If there is enough remaining space, create a free block,
     //coalesce it and insert it into the seg list.
-    if ((csize - asize) >= (OVERHEAD)) { 
-        PUT4(HDRP(bp), PACK(asize, 1));
-        PUT4(FTRP(bp), PACK(asize, 1));
+    if ((csize - asize) >= (MIN_BLOCK)) { 
+        PUT_TAG(HDRP(bp), PACK(asize, 1));
+        PUT_TAG(FTRP(bp), PACK(asize, 1));
         bp = NEXT_BLKP(bp);
-        PUT4(HDRP(bp), PACK(csize-asize, 0));
-        PUT4(FTRP(bp), PACK(csize-asize, 0));
+        PUT_TAG(HDRP(bp), PACK(csize-asize, 0));
+        PUT_TAG(FTRP(bp), PACK(csize-asize, 0));
         flist_insert(coalesce(bp));
     }
     //If there is not enough remaining space, simply allocate csize 
     //bytes as the allocated block.
     else { 
-        PUT4(HDRP(bp), PACK(csize, 1));
-        PUT4(FTRP(bp), PACK(csize, 1));
+        PUT_TAG(HDRP(bp), PACK(csize, 1));
+        PUT_TAG(FTRP(bp), PACK(csize, 1));
         
     }
 }
 
+/*
+ * adapt - Account for a FIT_ADAPTIVE search that wasted waste bytes on a
+ * request of asize, and was cut short by the depth if cut; adjust the
+ * depth at the end of each period.
+ */
+static void adapt(size_t waste, size_t asize, int cut)
+{
+    heap->adapt_waste += waste;
+    heap->adapt_asize += asize;
+    heap->adapt_cut += cut;
+    if (++heap->adapt_searches < ADAPT_PERIOD)
+        return;
+    if (heap->adapt_waste * ADAPT_WASTE_HI > heap->adapt_asize && heap->adapt_cut)
+        heap->adapt_depth = MIN(2 * heap->adapt_depth, ADAPT_MAX_DEPTH);
+    else if (heap->adapt_waste * ADAPT_WASTE_LO < heap->adapt_asize)
+        heap->adapt_depth = MAX(heap->adapt_depth / 2, 1);
+    heap->adapt_searches = heap->adapt_cut = 0;
+    heap->adapt_waste = heap->adapt_asize = 0;
+}
+
+/*
+ * find_next - FIT_NEXT: first block of at least asize bytes in seg list
+ * i, starting at its rover and wrapping around to the front.
+ */
+static void *find_next(int i, size_t asize) {
+    void *start = heap->rover[i] ? heap->rover[i] : GET_FREE(SEG_ROOT(i));
+    void *this = start;
+    int wrapped = 0;
+
+    void *next;
+
+    while (this != NULL) {
+        FIT_STAT(fit_stats.visited++);
+        next = GET_FREE(NEXT_FREE(this));
+        if (next != NULL)
+            __builtin_prefetch(HDRP(next));
+        if (asize <= GET_SIZE(HDRP(this))) {
+            heap->rover[i] = next;
+            return this;
+        }
+        this = next;
+        if (this == NULL && !wrapped) {
+            this = GET_FREE(SEG_ROOT(i));
+            wrapped = 1;
+        }
+        if (this == start)
+            break;
+    }
+    return NULL;
+}
+
 /* 
  * find - Given an index i to a specific seg list and asize, 
  * find a block of at least asize bytes in the seg list.
  */
-static void* find(size_t i, size_t asize) {
-    void *this = NULL; //pointer to seg free list
-    void *best_bp;
-    size_t size;
-    long best_diff = -1;
-    long this_diff;
+static void* find(int i, size_t asize) {
+    void *this, *next;
+    void *best_bp = NULL;
+    size_t size, best_size = 0;
     int counter = 0;
-    /* Determine which list to search in based on i*/
-    switch (i) {
-        case 1: 
-            this = GET_FREE(seg_start + SEG1);
-            break;
-        case 2:
-            this = GET_FREE(seg_start + SEG2);
-            break;
-        case 3:
-            this = GET_FREE(seg_start + SEG3);
-            break;
-        case 4:
-            this = GET_FREE(seg_start + SEG4);
-            break;
-        case 5:
-            this = GET_FREE(seg_start + SEG5);
-            break;
-        case 6:
-            this = GET_FREE(seg_start + SEG6);
-            break;
-        case 7:
-            this = GET_FREE(seg_start + SEG7);
+    int depth;
+    /*The default (FIT_GOOD) is a combination of best fit and first fit. 
+    The function starts searching form the beginning of the seg list, but 
+    does not return the first free block it finds. It searches through 
+    SEARCH_DEPTH (9) consecutive free blocks and returns the block that fits
+    best with the given size, i.e., results in the least wastage of space. 
+    The number 9 was chosen as it was found to have the right balance 
+    between throughput and utilization. First fit and best fit are the 
+    same search with a depth of 1 and of the whole list.*/
+    switch (fit_policy) {
+        case FIT_FIRST:
+            depth = 1;
             break;
-        case 8:
-            this = GET_FREE(seg_start + SEG8);
+        case FIT_NEXT:
+            return find_next(i, asize);
+        case FIT_BEST:
+            depth = -1;
             break;
-        case 9:
-            this = GET_FREE(seg_start + SEG9);
+        case FIT_ADAPTIVE:
+            depth = heap->adapt_depth;
             break;
-        case 10:
-            this = GET_FREE(seg_start + SEG10);
-            break;
-        case 11:
-            this = GET_FREE(seg_start + SEG11);
-            break;
-        case 12:
-            this = GET_FREE(seg_start + SEG12);
-            break;
-        case 13:
-            this = GET_FREE(seg_start + SEG13);
-            break;
-        case 14:
-            this = GET_FREE(seg_start + SEG14);
+        default:
+            depth = SEARCH_DEPTH;
             break;
     }
-    best_bp = this;
-    /*Combination of best fit and first fit. The function starts searching
-    form the beginning of the seg list, but does not return the first free 
-    block it finds. It searches through 9 consecutive free blocks and returns
-    the block that fits best with the given size, i.e., results in the least
-    wastage of space. The number 9 was chosen as it was found to have the right
-    balance between throughput and utilization.*/
+#if SUMMARY_LEN > 0
+    //First the summarized blocks: which of them fit, all compared at
+    //once, and then the same search over those.
+    summary_t *s = &heap->summary[i];
+    tag_t key = PACK(asize, 0);
+    unsigned int fits = 0;
+    int k, stop = 0;
+
+    if (heap->summary_len[i] == 0)
+        return NULL;
+    for (k = 0; k < SUMMARY_LEN; k++)
+        fits |= (unsigned int)(s->tag[k] >= key) << k;
+    if (heap->summary_len[i] < SUMMARY_LEN)
+        fits &= (1u << heap->summary_len[i]) - 1;
+    while (fits && !stop) {
+        k = __builtin_ctz(fits);
+        fits &= fits - 1;
+        size = TAG_SIZE(s->tag[k]);
+        if ((best_bp == NULL) || (size < best_size)) {
+            best_size = size;
+            best_bp = s->bp[k];
+        }
+        stop = (++counter == depth) || (size == asize);
+    }
+    FIT_STAT(fit_stats.visited += stop ? k + 1 : heap->summary_len[i]);
+    //Then the rest of the list, if the summary does not cover it.
+    this = (stop || heap->summary_len[i] < SUMMARY_LEN) ? NULL :
+        GET_FREE(NEXT_FREE(s->bp[SUMMARY_LEN - 1]));
+#else
+    this = GET_FREE(SEG_ROOT(i));
+#endif
+    //Each block tells where the next one is; fetch its header while
+    //this one is looked at.
     while (this != NULL) {
-        if (counter >= 9) return best_bp;
+        FIT_STAT(fit_stats.visited++);
+        next = GET_FREE(NEXT_FREE(this));
+        if (next != NULL)
+            __builtin_prefetch(HDRP(next));
         size = GET_SIZE(HDRP(this));
         if (asize <= size) {
-            counter++;
-            this_diff = size - asize;
-            if ((this_diff < best_diff) || (best_diff == -1)) {
-                best_diff = this_diff;
+            if ((best_bp == NULL) || (size < best_size)) {
+                best_size = size;
                 best_bp = this;
             }
+            //nothing fits better than an exact fit
+            if ((++counter == depth) || (size == asize)) break;
         }
-        this = GET_FREE(NEXT_FREE(this));
+        this = next;
     }
-    if (best_diff == -1) return NULL; //no block was found
-    else return best_bp;
+    if ((fit_policy == FIT_ADAPTIVE) && (best_bp != NULL))
+        adapt(best_size - asize, asize, counter == depth);
+    return best_bp;
 }
 
 /* 
@@ -478,70 +930,30 @@ static void* find(size_t i, size_t asize) {
  */
 static void *find_fit(size_t asize)
 {
-    size_t i;
+    int i;
     void *bp = NULL;
-    //Determine which seg list to look in.
-    if (asize <= MAX1) {
-        for (i = 1; i < NUM_SEGS + 1; i++) {
-            if ((bp = find(i, asize)) != NULL) return bp;
-        }
-    } else if (asize <= MAX2) {
-        for (i = 2; i < NUM_SEGS + 1; i++) {
-            if ((bp = find(i, asize)) != NULL) return bp;
-        }
-    } else if (asize <= MAX3) {
-        for (i = 3; i < NUM_SEGS + 1; i++) {
-            if ((bp = find(i, asize)) != NULL) return bp;
-        }
-    } else if (asize <= MAX4) {
-        for (i = 4; i < NUM_SEGS + 1; i++) {
-            if ((bp = find(i, asize)) != NULL) return bp;
-        }
-    } else if (asize <= MAX5) {
-        for (i = 5; i < NUM_SEGS + 1; i++) {
-            if ((bp = find(i, asize)) != NULL) return bp;
-        }
-    } else if (asize <= MAX6) {
-        for (i = 6; i < NUM_SEGS + 1; i++) {
-            if ((bp = find(i, asize)) != NULL) return bp;
-        }
-    } else if (asize <= MAX7) {
-        for (i = 7; i < NUM_SEGS + 1; i++) {
-            if ((bp = find(i, asize)) != NULL) return bp;
-        }
-    } else if (asize <= MAX8) {
-        for (i = 8; i < NUM_SEGS + 1; i++) {
-            if ((bp = find(i, asize)) != NULL) return bp;
-        }
-    } else if (asize <= MAX9) {
-        for (i = 9; i < NUM_SEGS + 1; i++) {
-            if ((bp = find(i, asize)) != NULL) return bp;
-        }
-    } else if (asize <= MAX10) {
-        for (i = 10; i < NUM_SEGS + 1; i++) {
-            if ((bp = find(i, asize)) != NULL) return bp;
-        }
-    } else if (asize <= MAX11) {
-        for (i = 11; i < NUM_SEGS + 1; i++) {
-            if ((bp = find(i, asize)) != NULL) return bp;
-        }
-    } else if (asize <= MAX12) {
-        for (i = 12; i < NUM_SEGS + 1; i++) {
-            if ((bp = find(i, asize)) != NULL) return bp;
-        }
-    } else if (asize <= MAX13) {
-        for (i = 13; i < NUM_SEGS + 1; i++) {
-            if ((bp = find(i, asize)) != NULL) return bp;
-        }
-    } else {
-        for (i = 14; i < NUM_SEGS + 1; i++) {
-            if ((bp = find(i, asize)) != NULL) return bp;
-        }
+#ifdef MM_INTERNALS
+    long visited = fit_stats.visited;
+    fit_stats.searches++;
+#endif
+    //Start at the seg list for asize, and move up to larger ones.
+    for (i = class_of(asize); i < NUM_SEGS; i++) {
+        FIT_STAT(fit_stats.lists++);
+        if ((bp = find(i, asize)) != NULL) break;
     }
+#ifdef MM_INTERNALS
+    visited = fit_stats.visited - visited;
+    fit_stats.max_visited = MAX(fit_stats.max_visited, visited);
+    fit_stats.misses += (bp == NULL);
+#endif
     return bp;
 }
 
 
+/* Problems the last checkheap() found; each is printed as it is found */
+static int check_errors;
+#define check_error(...) (check_errors++, printf(__VA_ARGS__))
+
 /* 
  * printblock - Helper function for checkheap() that prints each block.
  */
@@ -559,15 +971,15 @@ static void printblock(void *bp, int free)
         return;
     }
     if (!free) {
-        printf("%p: header: [%d:%c] footer: [%d:%c]\n", bp, 
-            (int)hsize, (halloc ? 'a' : 'f'), 
-            (int)fsize, (falloc ? 'a' : 'f')); 
+        printf("%p: header: [%zu:%c] footer: [%zu:%c]\n", bp, 
+            hsize, (halloc ? 'a' : 'f'), 
+            fsize, (falloc ? 'a' : 'f')); 
     } else {
-        printf("%p: header: [%d:%c]; prev: [%p]; next: [%p]; \
-            footer: [%d:%c]\n", bp, 
-            (int)hsize, (halloc ? 'a' : 'f'), 
+        printf("%p: header: [%zu:%c]; prev: [%p]; next: [%p]; \
+            footer: [%zu:%c]\n", bp, 
+            hsize, (halloc ? 'a' : 'f'), 
             GET_FREE(PREV_FREE(bp)), GET_FREE(NEXT_FREE(bp)),
-            (int)fsize, (falloc ? 'a' : 'f')); 
+            fsize, (falloc ? 'a' : 'f')); 
     }
     
 }
@@ -578,150 +990,130 @@ static void printblock(void *bp, int free)
  */
 static void checkblock(void *bp) 
 {
-    //check alignment
-    if ((size_t)bp % ALIGNMENT)
-        printf("Error: %p is not doubleword aligned\n", bp);
+    //check alignment (not of the prologue, which has no payload)
+    if (bp != heap->heap_listp && (size_t)bp % ALIGNMENT)
+        check_error("Error: %p is not %d-byte aligned\n", bp, ALIGNMENT);
     //check that header == footer
-    if (GET4(HDRP(bp)) != GET4(FTRP(bp)))
-        printf("Error: header does not match footer\n");
+    if (GET_TAG(HDRP(bp)) != GET_TAG(FTRP(bp)))
+        check_error("Error: header does not match footer\n");
 }
 
 /* 
- * print_free_list - Helper function for checkheap() that prints
- * each seg free list so it is easier to view what the heap looks like.
+ * print_free_list - Helper function for checkheap() that checks each
+ * seg free list, and in verbose mode prints it so it is easier to view
+ * what the heap looks like. Returns the number of blocks on the list.
  */
-static void print_free_list(int offset, int verbose) {
+static int print_free_list(int i, int verbose) {
     void *ptr;
     size_t min, max;
     size_t size;
-    size_t s;
-    int num = 1 + offset/FREE_PTR_SIZE;
-    switch (num) {
-        case 1: 
-            min = 0;
-            max = MAX1;
-            s = SEG1;
-            break;
-        case 2:
-            min = MAX1;
-            max = MAX2;
-            s = SEG2;
-            break;
-        case 3:
-            min = MAX2;
-            max = MAX3;
-            s = SEG3;
-            break;
-        case 4:
-            min = MAX3;
-            max = MAX4;
-            s = SEG4;
-            break;
-        case 5:
-            min = MAX4;
-            max = MAX5;
-            s = SEG5;
-            break;
-        case 6:
-            min = MAX5;
-            max = MAX6;
-            s = SEG6;
-            break;
-        case 7:
-            min = MAX6;
-            max = MAX7;
-            s = SEG7;
-            break;
-        case 8:
-            min = MAX7;
-            max = MAX8;
-            s = SEG8;
-            break;
-        case 9:
-            min = MAX8;
-            max = MAX9;
-            s = SEG9;
-            break;
-        case 10:
-            min = MAX9;
-            max = MAX10;
-            s = SEG10;
-            break;
-        case 11:
-            min = MAX10;
-            max = MAX11;
-            s = SEG11;
-            break;
-        case 12:
-            min = MAX11;
-            max = MAX12;
-            s = SEG12;
-            break;
-        case 13:
-            min = MAX12;
-            max = MAX13;
-            s = SEG13;
-            break;
-        case 14:
-            min = MAX13;
-            max = ~0;
-            s = SEG14;
-            break;
-    }
-    printf("%s %d\n", "Start of Free List number", num);
-    for (ptr = GET_FREE(seg_start + s); ptr != NULL;
-        ptr = GET_FREE(NEXT_FREE(ptr))) {
+    int num = i + 1;
+    int k = 0;
+    min = i ? class_max[i - 1] : 0;
+    max = class_max[i];
+    if (verbose) printf("%s %d\n", "Start of Free List number", num);
+    for (ptr = GET_FREE(SEG_ROOT(i)); ptr != NULL;
+        ptr = GET_FREE(NEXT_FREE(ptr)), k++) {
         size = GET_SIZE(HDRP(ptr));
+#if SUMMARY_LEN > 0
+        //Check that the summary mirrors the front of the list.
+        if (k < heap->summary_len[i] && (heap->summary[i].bp[k] != ptr ||
+            heap->summary[i].tag[k] != GET_TAG(HDRP(ptr)))) {
+            check_error("Summary entry %d of free list %d is not block %p\n",
+                k, num, ptr);
+        }
+#endif
         //Check that block ptr is in the right seg list.
         if (!(min < size && size <= max)) {
-            printf("Free block pointer %p is in the wrong seg list.\n", ptr);
+            check_error("Free block pointer %p is in the wrong seg list.\n", ptr);
+        }
+        if (GET_ALLOC(HDRP(ptr))) {
+            check_error("Block %p on free list %d is allocated\n", ptr, num);
         }
         if (verbose) printblock(ptr, 1);
 
     }
-    printf("%s %d\n", "End of Free List number", num);
-    
+#if SUMMARY_LEN > 0
+    if (heap->summary_len[i] != MIN(k, SUMMARY_LEN))
+        check_error("Summary of free list %d holds %d blocks, not %d\n",
+            num, heap->summary_len[i], MIN(k, SUMMARY_LEN));
+#endif
+    if (verbose) printf("%s %d\n", "End of Free List number", num);
+    return k;
 }
 
 /*
- * Initialize: return -1 on error, 0 on success.
+ * check_quick_lists - Helper function for checkheap() that checks that
+ * the blocks on each quick-list are allocated, of the list's size, and
+ * as many as quick_count says.
  */
-int mm_init(void) {
-    heap_listp = NULL;
-    seg_start = NULL;
+static void check_quick_lists(void) {
+    void *ptr;
+    size_t size;
+    int count = 0;
+    for (int i = MIN_BLOCK / ALIGNMENT; i < QUICK_LISTS; i++) {
+        size = i * ALIGNMENT;
+        for (ptr = GET_FREE(QUICK_ROOT(size)); ptr != NULL;
+            ptr = GET_FREE(ptr)) {
+            if (GET_SIZE(HDRP(ptr)) != size || !GET_ALLOC(HDRP(ptr)))
+                check_error("Quick-list block %p is not an allocated %d byte "
+                    "block\n", ptr, (int)size);
+            count++;
+        }
+    }
+    if (count != heap->quick_count)
+        check_error("Quick-lists hold %d blocks, not %d\n", count, heap->quick_count);
+}
+
+/*
+ * heap_init - Lay out an empty heap in the current memlib region:
+ * return -1 on error, 0 on success.
+ */
+static int heap_init(void) {
+    void *fresh = mem_zero_lo();
+    heap->heap_listp = NULL;
+    heap->seg_start = NULL;
+    heap->wilderness = NULL;
+    heap->huge_page = mem_huge_pagesize();
+    heap->grow_size = CHUNKSIZE;
+    heap->grow_mallocs = 0;
     void* flist_root;
     /* Create space for seg list pointers. */
-    if ((seg_start = mem_sbrk(NUM_SEGS*DSIZE)) == NULL) {
+    if ((long)(heap->seg_start = mem_sbrk(ALIGN((NUM_SEGS + QUICK_LISTS)*DSIZE))) < 0) {
         return -1;
     }
 
+    /* The tags must describe any block the rest of the heap can hold */
+    if (mem_max_heap() - mem_heapsize() > MAX_BLOCK)
+        return -1;
+
     /* Create the initial empty heap */
-    if ((heap_listp = mem_sbrk(4*WSIZE)) == NULL) {
+    if ((long)(heap->heap_listp = mem_sbrk(PROLOGUE_PAD + PROLOGUE + H_SIZE)) < 0) {
         return -1;
     }
 
-    PUT4(heap_listp, 0); /* Alignment padding */
-    PUT4(heap_listp + (1*WSIZE), PACK(DSIZE, 1)); /* Prologue header */
-    PUT4(heap_listp + (2*WSIZE), PACK(DSIZE, 1)); /* Prologue footer */
-    PUT4(heap_listp + (3*WSIZE), PACK(0, 1)); /* Epilogue header */
-    heap_listp += (2*WSIZE); //heap pointer points to the space in
+    heap->heap_listp += PROLOGUE_PAD; /* Alignment padding */
+    PUT_TAG(heap->heap_listp, PACK(PROLOGUE, 1)); /* Prologue header */
+    PUT_TAG(heap->heap_listp + H_SIZE, PACK(PROLOGUE, 1)); /* Prologue footer */
+    PUT_TAG(heap->heap_listp + PROLOGUE, PACK(0, 1)); /* Epilogue header */
+    heap->heap_listp += H_SIZE; //heap pointer points to the space in
     //between the prologue header and prologue footer.
+    heap->zero_start = MAX(fresh, (void *)mem_heap_hi() + 1);
 
     //Initialize seg list pointers to NULL
-    PUT(seg_start + SEG1, (size_t) NULL);
-    PUT(seg_start + SEG2, (size_t) NULL);
-    PUT(seg_start + SEG3, (size_t) NULL);
-    PUT(seg_start + SEG4, (size_t) NULL);
-    PUT(seg_start + SEG5, (size_t) NULL);
-    PUT(seg_start + SEG6, (size_t) NULL);
-    PUT(seg_start + SEG7, (size_t) NULL);
-    PUT(seg_start + SEG8, (size_t) NULL);
-    PUT(seg_start + SEG9, (size_t) NULL);
-    PUT(seg_start + SEG10, (size_t) NULL);
-    PUT(seg_start + SEG11, (size_t) NULL);
-    PUT(seg_start + SEG12, (size_t) NULL);
-    PUT(seg_start + SEG13, (size_t) NULL);
-    PUT(seg_start + SEG14, (size_t) NULL);
+    for (int i = 0; i < NUM_SEGS; i++) {
+        PUT(SEG_ROOT(i), (size_t) NULL);
+        heap->rover[i] = NULL;
+#if SUMMARY_LEN > 0
+        heap->summary_len[i] = 0;
+#endif
+    }
+    for (int i = 0; i < QUICK_LISTS; i++)
+        PUT(QUICK_ROOT(i * ALIGNMENT), (size_t) NULL);
+    heap->quick_count = 0;
+    heap->adapt_depth = SEARCH_DEPTH;
+    heap->adapt_searches = heap->adapt_cut = 0;
+    heap->adapt_waste = heap->adapt_asize = 0;
 
     /* Extend the empty heap with a free block of CHUNKSIZE bytes */
     flist_root = extend_heap(CHUNKSIZE/WSIZE);
@@ -731,40 +1123,135 @@ int mm_init(void) {
     return 0;
 }
 
+/*
+ * Initialize: return -1 on error, 0 on success.
+ */
+int mm_init(void) {
+    heap = &main_heap;
+    mem_select(NULL);
+    return heap_init();
+}
+
+/*
+ * find_block - Find a free block of at least asize bytes, growing the
+ * heap if need be, and return it still free (on its list, or the
+ * wilderness); NULL if the heap cannot grow.
+ */
+static inline void *find_block(size_t asize)
+{
+    size_t extendsize; /* amount to extend heap if no fit */
+    void *bp;
+
+    /* Search the free list for a fit, with the quick-lists freed if the
+       first search fails */
+    if ((bp = find_fit(asize)) != NULL ||
+        (heap->quick_count > 0 && (consolidate(), bp = find_fit(asize)) != NULL))
+        return bp;
+
+    /* Then take it from the top of the heap */
+    if (heap->wilderness != NULL && GET_SIZE(HDRP(heap->wilderness)) >= asize)
+        return heap->wilderness;
+
+    /* No fit found. Get more memory, which the wilderness grows into */
+    extendsize = asize;
+    if (heap->wilderness != NULL)
+        extendsize -= GET_SIZE(HDRP(heap->wilderness));
+    extendsize = MAX(extendsize,growth());
+    FIT_STAT(fit_stats.grows++);
+    if ((bp = extend_heap(extendsize/WSIZE)) == NULL) {
+        printf("%s\n", "Could not extend heap");
+        return NULL;
+    }
+    return bp;
+}
+
+/*
+ * align_up - First payload address from bp on that is aligned to align
+ * and leaves room for a free block before it, if it is not bp itself
+ */
+static inline void *align_up(void *bp, size_t align)
+{
+    void *abp = (void *)(((size_t)bp + align - 1) & ~(align - 1));
+    while (abp != bp && (size_t)(abp - bp) < MIN_BLOCK)
+        abp += align;
+    return abp;
+}
+
+/*
+ * malloc_aligned - Allocate a block of asize bytes whose payload is
+ * aligned to align, a power of two. The block is cut from a free one
+ * with room for the alignment, and what comes before it is freed again.
+ * At the top of the heap, the heap grows only as far as the block ends.
+ */
+static void *malloc_aligned(size_t align, size_t asize)
+{
+    void *bp, *abp, *top;
+    size_t csize, pad, need, wsize;
+
+    if (align > MAX_BLOCK - MIN_BLOCK || asize > MAX_BLOCK - align - MIN_BLOCK)
+        return NULL;
+    csize = asize + align + MIN_BLOCK;
+    if ((bp = find_fit(csize)) == NULL &&
+        !(heap->quick_count > 0 && (consolidate(), bp = find_fit(csize)) != NULL)) {
+        top = heap->wilderness ? heap->wilderness : (void *)mem_heap_hi() + 1;
+        wsize = heap->wilderness ? GET_SIZE(HDRP(heap->wilderness)) : 0;
+        need = (align_up(top, align) - top) + asize;
+        if (need <= wsize) {
+            bp = heap->wilderness;
+        } else {
+            FIT_STAT(fit_stats.grows++);
+            if ((bp = extend_heap((need - wsize)/WSIZE)) == NULL) {
+                printf("%s\n", "Could not extend heap");
+                return NULL;
+            }
+        }
+    }
+
+    abp = align_up(bp, align);
+    if (abp != bp) {
+        csize = GET_SIZE(HDRP(bp));
+        pad = abp - bp;
+        splice_block(bp);
+        PUT_TAG(HDRP(bp), PACK(pad, 0));
+        PUT_TAG(FTRP(bp), PACK(pad, 0));
+        PUT_TAG(HDRP(abp), PACK(csize - pad, 0));
+        PUT_TAG(FTRP(abp), PACK(csize - pad, 0));
+        flist_insert(bp);
+        flist_insert(abp);
+        bp = abp;
+    }
+    place(bp, asize);
+    return bp;
+}
+
 /*
  * malloc - given a size, malloc allocates size bytes of payload in the 
  * heap and returns a pointer to that block.
  */
 void *malloc (size_t size) {
     size_t asize;      /* adjusted block size */
-    size_t extendsize; /* amount to extend heap if no fit */
     void *bp;      
 
-    /* Ignore spurious requests */
-    if (size <= 0)
+    /* Ignore spurious requests, and ones no block can hold */
+    if (size == 0 || size > MAX_PAYLOAD)
         return NULL;
     /* Adjust block size to include overhead and alignment reqs. */
-    if (size <= ALIGNMENT) {
-        asize = OVERHEAD;
-    }
-    else {
-        asize = ALIGNMENT * ((size + (ALLOC_OVERHEAD) + 
-            (ALIGNMENT-1)) / ALIGNMENT);
-    }
+    asize = adjust_size(size);
+    heap->grow_mallocs++;
 
-    /* Search the free list for a fit */
-    if ((bp = find_fit(asize)) != NULL) {
-        place(bp, asize);
+    /* Reuse a freed block of the same size, still allocated */
+    if (IS_QUICK(asize) && (bp = GET_FREE(QUICK_ROOT(asize))) != NULL) {
+        PUTP(QUICK_ROOT(asize), GET_FREE(bp));
+        heap->quick_count--;
         return bp;
     }
 
-    /* No fit found. Get more memory and place the block */
-    extendsize = MAX(asize,CHUNKSIZE);
-    if ((bp = extend_heap(extendsize/WSIZE)) == NULL) {
-        printf("%s\n", "Could not extend heap");
+    /* Blocks of a huge page or more get one to themselves */
+    if (heap->huge_page && asize >= heap->huge_page)
+        return malloc_aligned(heap->huge_page, asize);
+
+    if ((bp = find_block(asize)) == NULL)
         return NULL;
-    }
-        
     place(bp, asize);
     return bp;
 }
@@ -778,8 +1265,17 @@ void free (void *ptr) {
 
     size_t size = GET_SIZE(HDRP(ptr)); //size of input ptr
 
-    PUT4(HDRP(ptr), PACK(size, 0));
-    PUT4(FTRP(ptr), PACK(size, 0));
+    /* Small blocks wait on their quick-list, allocated and unmerged */
+    if (IS_QUICK(size)) {
+        PUTP(ptr, GET_FREE(QUICK_ROOT(size)));
+        PUTP(QUICK_ROOT(size), ptr);
+        if (++heap->quick_count > QUICK_LIMIT)
+            consolidate();
+        return;
+    }
+
+    PUT_TAG(HDRP(ptr), PACK(size, 0));
+    PUT_TAG(FTRP(ptr), PACK(size, 0));
     flist_insert(coalesce(ptr));
 }
 
@@ -813,7 +1309,7 @@ void *realloc(void *oldptr, size_t size)
   /* Copy the old data. */
   oldsize = GET_SIZE(HDRP(oldptr));
   if(size < oldsize) oldsize = size;
-  memcpy(newptr, oldptr, oldsize);
+  memops_copy(newptr, oldptr, oldsize);
 
   /* Free the old block. */
   free(oldptr);
@@ -822,42 +1318,603 @@ void *realloc(void *oldptr, size_t size)
 }
 
 /*
- * calloc - you may want to look at mm-naive.c
- * This function is not tested by mdriver, but it is
- * needed to run the traces.
+ * calloc - Allocate an array of nmemb elements of size bytes, cleared.
+ * Only the part of the block that lies below zero_start needs clearing.
  */
 void *calloc (size_t nmemb, size_t size) {
-    size_t total_size = nmemb * size;
+    size_t total_size;
+    void *zero = heap->zero_start;
     void *newptr;
-    newptr = malloc(total_size);
-    memset(newptr, 0, total_size);
+
+    if (nmemb != 0 && size > (size_t)-1 / nmemb)
+        return NULL;
+    total_size = nmemb * size;
+    if ((newptr = malloc(total_size)) == NULL)
+        return NULL;
+    if (newptr < zero)
+        memops_zero(newptr, MIN(total_size, (size_t)(zero - newptr)));
     return newptr;
 }
 
+/*
+ * memalign - Allocate size bytes of payload at a multiple of alignment,
+ * a power of two; NULL if it is not one.
+ */
+void *memalign(size_t alignment, size_t size) {
+    size_t asize;
+
+    if (alignment == 0 || (alignment & (alignment - 1)))
+        return NULL;
+    if (alignment <= ALIGNMENT)
+        return malloc(size);
+    if (size == 0 || size > MAX_PAYLOAD)
+        return NULL;
+    asize = adjust_size(size);
+    heap->grow_mallocs++;
+    if (heap->huge_page && asize >= heap->huge_page)
+        alignment = MAX(alignment, heap->huge_page);
+    return malloc_aligned(alignment, asize);
+}
+
+/*
+ * posix_memalign - memalign, for an alignment that is also a multiple
+ * of sizeof(void *). Returns EINVAL if it is not, ENOMEM if there is no
+ * room; a request of 0 bytes sets *memptr to NULL.
+ */
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    void *p;
+
+    if (alignment == 0 || (alignment & (alignment - 1)) ||
+        alignment % sizeof(void *))
+        return EINVAL;
+    if (size == 0) {
+        *memptr = NULL;
+        return 0;
+    }
+    if ((p = memalign(alignment, size)) == NULL)
+        return ENOMEM;
+    *memptr = p;
+    return 0;
+}
+
+/*
+ * aligned_alloc - The C11 name for memalign
+ */
+void *aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+/*
+ * free_sized - free, for a caller that knows the size of the block: any
+ * size from the one it asked for up to malloc_usable_size. Blocks carry
+ * unsplit slack, so the header still says where the footer is; unless
+ * built with NDEBUG, the size is checked against it.
+ */
+void free_sized(void *ptr, size_t size) {
+    (void)size;
+    assert(ptr == NULL ||
+           (size <= GET_SIZE(HDRP(ptr)) - ALLOC_OVERHEAD &&
+            GET_SIZE(HDRP(ptr)) < adjust_size(size) + MIN_BLOCK));
+    free(ptr);
+}
+
+/*
+ * malloc_usable_size - Bytes of payload the block at ptr has: its
+ * request, and whatever place() did not split off; 0 for NULL.
+ */
+size_t malloc_usable_size(void *ptr) {
+    if (!ptr)
+        return 0;
+    return GET_SIZE(HDRP(ptr)) - ALLOC_OVERHEAD;
+}
+
+/*
+ * carve - Place k blocks of asize bytes one after the other at the start
+ * of free block bp, and store them in out[]. The run is placed as one
+ * block and then tagged; its last block takes any slack.
+ */
+static void carve(void *bp, size_t asize, size_t k, void **out)
+{
+    size_t csize;
+
+    place(bp, k * asize);
+    csize = GET_SIZE(HDRP(bp));
+    for (; k > 1; k--, bp += asize, csize -= asize) {
+        PUT_TAG(HDRP(bp), PACK(asize, 1));
+        PUT_TAG(FTRP(bp), PACK(asize, 1));
+        *out++ = bp;
+    }
+    PUT_TAG(HDRP(bp), PACK(csize, 1));
+    PUT_TAG(FTRP(bp), PACK(csize, 1));
+    *out = bp;
+}
+
+/*
+ * malloc_batch - Allocate n blocks of size bytes into out[], and return
+ * how many it could. Blocks waiting on the quick-list of their size go
+ * first. The rest are carved from as few free blocks as will hold them:
+ * a search for room for all of them, then for half as many, and so on,
+ * takes as many as the block it finds holds. When not even one fits,
+ * the rest come from the top of the heap, grown once.
+ */
+size_t malloc_batch(size_t size, size_t n, void **out) {
+    size_t asize, i = 0, k;
+    void *bp;
+
+    if (size == 0 || size > MAX_PAYLOAD)
+        return 0;
+    asize = adjust_size(size);
+
+    if (IS_QUICK(asize)) {
+        while (i < n && (bp = GET_FREE(QUICK_ROOT(asize))) != NULL) {
+            PUTP(QUICK_ROOT(asize), GET_FREE(bp));
+            heap->quick_count--;
+            out[i++] = bp;
+        }
+    }
+
+    /* Blocks of a huge page or more are aligned one by one, below */
+    if (i < n && !(heap->huge_page && asize >= heap->huge_page) &&
+        n - i <= MAX_PAYLOAD / asize) {
+        heap->grow_mallocs += n - i;
+        while (i < n) {
+            for (k = n - i; k > 0 && (bp = find_fit(k * asize)) == NULL;
+                 k /= 2)
+                ;
+            if (k == 0 && (bp = find_block((n - i) * asize)) == NULL)
+                break;
+            k = MIN(n - i, GET_SIZE(HDRP(bp)) / asize);
+            carve(bp, asize, k, out + i);
+            i += k;
+        }
+    }
+
+    for (; i < n; i++)
+        if ((out[i] = malloc(size)) == NULL)
+            break;
+    return i;
+}
+
+/*
+ * free_batch - Free the n blocks in ptrs[]. Each run of them that lie
+ * next to each other is freed as one block: tagged once, coalesced once
+ * and inserted once. A block with no neighbour in the batch is freed as
+ * free() would; NULLs are skipped.
+ *
+ * First every block is tagged free and marked as pending by pointing
+ * its first word at itself, which no block on a list does. Then, from
+ * each block still pending, the run around it is found by walking to
+ * the first pending block before it and summing those after it.
+ */
+void free_batch(void **ptrs, size_t n) {
+    size_t i, size;
+    void *bp, *end;
+
+#define PENDING(bp) (!GET_ALLOC(HDRP(bp)) && GET_FREE(bp) == (bp))
+    for (i = 0; i < n; i++) {
+        if ((bp = ptrs[i]) == NULL)
+            continue;
+        size = GET_SIZE(HDRP(bp));
+        PUT_TAG(HDRP(bp), PACK(size, 0));
+        PUT_TAG(FTRP(bp), PACK(size, 0));
+        PUTP(bp, bp);
+    }
+
+    for (i = 0; i < n; i++) {
+        if ((bp = ptrs[i]) == NULL || !PENDING(bp))
+            continue;
+        while (PENDING(PREV_BLKP(bp)))
+            bp = PREV_BLKP(bp);
+        for (end = bp; PENDING(end); end = NEXT_BLKP(end))
+            PUTP(end, NULL);
+        size = end - bp;
+        if (NEXT_BLKP(bp) == end) {
+            PUT_TAG(HDRP(bp), PACK(size, 1));
+            PUT_TAG(FTRP(bp), PACK(size, 1));
+            free(bp);
+            continue;
+        }
+        PUT_TAG(HDRP(bp), PACK(size, 0));
+        PUT_TAG(FTRP(bp), PACK(size, 0));
+        flist_insert(coalesce(bp));
+    }
+#undef PENDING
+}
+
+/*
+ * heap_enter - Make h the heap the functions above work on, with its
+ * region selected in memlib, and return the one it replaces.
+ */
+static struct mm_heap *heap_enter(struct mm_heap *h) {
+    struct mm_heap *was = heap;
+
+    heap = h;
+    mem_select(h->mem);
+    return was;
+}
+
+/*
+ * mm_heap_create - Make a heap in a memlib region of its own, with its
+ * state at the bottom; NULL if there is no room for one.
+ */
+mm_heap_t *mm_heap_create(void) {
+    mem_t *mem;
+    struct mm_heap *h, *was;
+    int err;
+
+    if ((mem = mem_create()) == NULL)
+        return NULL;
+    mem_select(mem);
+    if ((long)(h = mem_sbrk(ALIGN(sizeof(*h)))) < 0) {
+        mem_select(heap->mem);
+        mem_destroy(mem);
+        return NULL;
+    }
+    h->mem = mem;
+    was = heap_enter(h);
+    err = heap_init();
+    heap_enter(was);
+    if (err) {
+        mem_destroy(mem);
+        return NULL;
+    }
+    return h;
+}
+
+/*
+ * mm_heap_destroy - Free every block of h, and h itself, by unmapping
+ * its region.
+ */
+void mm_heap_destroy(mm_heap_t *h) {
+    mem_destroy(h->mem);
+}
+
+/*
+ * mm_heap_malloc, mm_heap_free, mm_heap_realloc, mm_heap_calloc - As
+ * malloc and friends, on heap h. A block belongs to the heap it came
+ * from, and may only be freed or resized there.
+ */
+void *mm_heap_malloc(mm_heap_t *h, size_t size) {
+    struct mm_heap *was = heap_enter(h);
+    void *bp = malloc(size);
+
+    heap_enter(was);
+    return bp;
+}
+
+void mm_heap_free(mm_heap_t *h, void *ptr) {
+    struct mm_heap *was = heap_enter(h);
+
+    free(ptr);
+    heap_enter(was);
+}
+
+void *mm_heap_realloc(mm_heap_t *h, void *ptr, size_t size) {
+    struct mm_heap *was = heap_enter(h);
+    void *bp = realloc(ptr, size);
+
+    heap_enter(was);
+    return bp;
+}
+
+void *mm_heap_calloc(mm_heap_t *h, size_t nmemb, size_t size) {
+    struct mm_heap *was = heap_enter(h);
+    void *bp = calloc(nmemb, size);
+
+    heap_enter(was);
+    return bp;
+}
+
+/*
+ * mm_heap_checkheap - mm_checkheap on heap h.
+ */
+int mm_heap_checkheap(mm_heap_t *h, int verbose) {
+    struct mm_heap *was = heap_enter(h);
+    int errors = mm_checkheap(verbose);
+
+    heap_enter(was);
+    return errors;
+}
+
+/*
+ * A region: the chunk it bumps through, and what is left of it
+ */
+struct mm_region {
+    void *chunk;       /* the newest chunk, NULL before the first alloc */
+    char *next;
+    char *end;
+    size_t chunk_size; /* size of the next chunk */
+};
+
+/*
+ * mm_region_begin - Make an empty region; NULL if out of memory.
+ */
+mm_region_t *mm_region_begin(void) {
+    struct mm_region *r;
+
+    if ((r = malloc(sizeof(*r))) == NULL)
+        return NULL;
+    r->chunk = NULL;
+    r->next = r->end = NULL;
+    r->chunk_size = REGION_CHUNK;
+    return r;
+}
+
+/*
+ * region_grow - Allocate size (aligned) bytes of r from a new chunk.
+ */
+static void *region_grow(struct mm_region *r, size_t size) {
+    void *chunk;
+
+    if (size > MAX_PAYLOAD - REGION_HDR)
+        return NULL;
+    if (r->chunk != NULL && size > r->chunk_size / 4) {
+        if ((chunk = malloc(REGION_HDR + size)) == NULL)
+            return NULL;
+        PUTP(chunk, GET_FREE(r->chunk));
+        PUTP(r->chunk, chunk);
+        return chunk + REGION_HDR;
+    }
+    if ((chunk = malloc(MAX(r->chunk_size, REGION_HDR + size))) == NULL)
+        return NULL;
+    PUTP(chunk, r->chunk);
+    r->chunk = chunk;
+    r->next = chunk + REGION_HDR + size;
+    r->end = chunk + malloc_usable_size(chunk);
+    r->chunk_size = MIN(2 * r->chunk_size, REGION_CHUNK_MAX);
+    return chunk + REGION_HDR;
+}
+
+/*
+ * mm_region_alloc - Allocate size bytes of r, which are freed only with
+ * the whole region; NULL if size is 0 or out of memory.
+ */
+void *mm_region_alloc(mm_region_t *r, size_t size) {
+    char *p = r->next;
+
+    if (size == 0 || size > MAX_PAYLOAD)
+        return NULL;
+    size = ALIGN(size);
+    if (size <= (size_t)(r->end - p)) {
+        r->next = p + size;
+        return p;
+    }
+    return region_grow(r, size);
+}
+
+/*
+ * region_free - Free a list of chunks, REGION_BATCH to a free_batch,
+ * so neighbouring chunks go back to the seg lists as one block.
+ */
+static void region_free(void *chunk) {
+    void *batch[REGION_BATCH];
+    size_t n = 0;
+
+    for (; chunk != NULL; chunk = GET_FREE(chunk)) {
+        if (n == REGION_BATCH) {
+            free_batch(batch, n);
+            n = 0;
+        }
+        batch[n++] = chunk;
+    }
+    free_batch(batch, n);
+}
+
+/*
+ * mm_region_reset - Free everything allocated from r. The newest chunk
+ * is kept for what comes next; the others go back to the heap.
+ */
+void mm_region_reset(mm_region_t *r) {
+    if (r->chunk == NULL)
+        return;
+    region_free(GET_FREE(r->chunk));
+    PUTP(r->chunk, NULL);
+    r->next = r->chunk + REGION_HDR;
+}
+
+/*
+ * mm_region_end - Free everything allocated from r, and r itself.
+ */
+void mm_region_end(mm_region_t *r) {
+    region_free(r->chunk);
+    free(r);
+}
+
+/*
+ * A pool slab: its header, then its objects, from first on. The pool
+ * keeps its slabs on a circular list, the ones with free objects ahead
+ * of the full ones.
+ */
+struct pool_slab {
+    struct mm_pool *pool;
+    struct pool_slab *next, *prev;
+    void *free;        /* objects freed in this slab */
+    char *fresh;       /* objects never handed out start here */
+    size_t used;
+};
+
+struct mm_pool {
+    size_t slab_size;
+    size_t first;      /* offset of the first object in a slab */
+    size_t per_slab;   /* objects in a slab */
+    struct pool_slab slabs; /* list head */
+    size_t empty;      /* slabs with no object in use */
+    mm_pool_stats_t st;
+};
+
+static inline void slab_unlink(struct pool_slab *s) {
+    s->prev->next = s->next;
+    s->next->prev = s->prev;
+}
+
+static inline void slab_link(struct pool_slab *s, struct pool_slab *prev) {
+    s->prev = prev;
+    s->next = prev->next;
+    prev->next->prev = s;
+    prev->next = s;
+}
+
+/*
+ * mm_pool_create - Make a pool of objects of obj_size bytes aligned to
+ * align (0 for ALIGNMENT); NULL if align is not a power of two, or out
+ * of memory.
+ */
+mm_pool_t *mm_pool_create(size_t obj_size, size_t align) {
+    struct mm_pool *p;
+    size_t first, slab_size;
+
+    if (align == 0)
+        align = ALIGNMENT;
+    if ((align & (align - 1)) || obj_size == 0 ||
+        obj_size > MAX_PAYLOAD / (2 * POOL_MIN_OBJS) || align > MAX_PAYLOAD / 2)
+        return NULL;
+    obj_size = MAX(obj_size, sizeof(void *));
+    obj_size = (obj_size + align - 1) & ~(align - 1);
+    first = (sizeof(struct pool_slab) + align - 1) & ~(align - 1);
+    for (slab_size = POOL_SLAB;
+         slab_size < first + POOL_MIN_OBJS * obj_size + ALLOC_OVERHEAD ||
+         slab_size < align;
+         slab_size *= 2)
+        ;
+
+    if ((p = malloc(sizeof(*p))) == NULL)
+        return NULL;
+    p->slab_size = slab_size;
+    p->first = first;
+    p->per_slab = (slab_size - ALLOC_OVERHEAD - first) / obj_size;
+    p->slabs.next = p->slabs.prev = &p->slabs;
+    p->empty = 0;
+    memset(&p->st, 0, sizeof(p->st));
+    p->st.obj_size = obj_size;
+    p->st.slab_size = slab_size;
+    return p;
+}
+
+/*
+ * pool_grow - Put a new slab at the front of p; NULL if out of memory.
+ */
+static struct pool_slab *pool_grow(struct mm_pool *p) {
+    struct pool_slab *s;
+
+    if ((s = memalign(p->slab_size, p->slab_size - ALLOC_OVERHEAD)) == NULL)
+        return NULL;
+    s->pool = p;
+    s->free = NULL;
+    s->fresh = (char *)s + p->first;
+    s->used = 0;
+    slab_link(s, &p->slabs);
+    p->empty++;
+    p->st.slabs++;
+    return s;
+}
+
+/*
+ * mm_pool_alloc - An object of p; NULL if out of memory.
+ */
+void *mm_pool_alloc(mm_pool_t *p) {
+    struct pool_slab *s = p->slabs.next;
+    void *obj;
+
+    if (s == &p->slabs || s->used == p->per_slab) {
+        if ((s = pool_grow(p)) == NULL)
+            return NULL;
+    }
+    if ((obj = s->free) != NULL) {
+        s->free = GET_FREE(obj);
+    } else {
+        obj = s->fresh;
+        s->fresh += p->st.obj_size;
+    }
+    if (s->used++ == 0)
+        p->empty--;
+    if (s->used == p->per_slab) {
+        slab_unlink(s);
+        slab_link(s, p->slabs.prev);
+    }
+    p->st.allocs++;
+    if (++p->st.in_use > p->st.peak)
+        p->st.peak = p->st.in_use;
+    return obj;
+}
+
+/*
+ * mm_pool_free - Give obj back to p, the pool it came from. A slab that
+ * empties goes back to the heap, unless it is the only empty one.
+ */
+void mm_pool_free(mm_pool_t *p, void *obj) {
+    struct pool_slab *s;
+
+    if (obj == NULL)
+        return;
+    s = (void *)((size_t)obj & ~(p->slab_size - 1));
+    assert(s->pool == p);
+    PUTP(obj, s->free);
+    s->free = obj;
+    if (s->used-- == p->per_slab) {
+        slab_unlink(s);
+        slab_link(s, &p->slabs);
+    }
+    p->st.frees++;
+    p->st.in_use--;
+    if (s->used == 0 && p->empty++ > 0) {
+        slab_unlink(s);
+        free(s);
+        p->empty--;
+        p->st.slabs--;
+        p->st.slabs_freed++;
+    }
+}
+
+/*
+ * mm_pool_stats - What p holds, and what it has done.
+ */
+void mm_pool_stats(mm_pool_t *p, mm_pool_stats_t *st) {
+    *st = p->st;
+    st->capacity = p->st.slabs * p->per_slab;
+}
+
+/*
+ * mm_pool_destroy - Give back every slab of p, objects in use or not,
+ * and p itself.
+ */
+void mm_pool_destroy(mm_pool_t *p) {
+    struct pool_slab *s, *next;
+
+    for (s = p->slabs.next; s != &p->slabs; s = next) {
+        next = s->next;
+        free(s);
+    }
+    free(p);
+}
+
 /*
  * mm_checkheap - Function for debugging. Checks the invariants in the 
  * heap and prints out the heap very clearly so it is easy to debug.
+ * Returns the number of problems it found.
  */
-void mm_checkheap(int verbose) {
-    void *bp = heap_listp;
+int mm_checkheap(int verbose) {
+    void *bp = heap->heap_listp;
     void *prev = NULL;
+    int nfree = 0, nlisted = 0;
+
+    check_errors = 0;
 
     //In verbose mode, print out the heap block by block.
     if (verbose)
-        printf("Heap (%p):\n", heap_listp);
+        printf("Heap (%p):\n", heap->heap_listp);
     //Check prologue.
-    if ((GET_SIZE(HDRP(heap_listp)) != DSIZE) || !GET_ALLOC(HDRP(heap_listp)))
-        printf("Bad prologue header\n");
-    checkblock(heap_listp);
+    if ((GET_SIZE(HDRP(heap->heap_listp)) != PROLOGUE) || !GET_ALLOC(HDRP(heap->heap_listp)))
+        check_error("Bad prologue header\n");
+    checkblock(heap->heap_listp);
     //This for loop prints and checks each block in the entire heap.
-    for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+    for (bp = heap->heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
         if (verbose) {
             printblock(bp, 0);
         }
         //Check for adjacent free blocks.
         if (prev != NULL) {
             if (!GET_ALLOC(HDRP(prev)) && !GET_ALLOC(HDRP(bp))) {
-                printf("Adjacent free blocks: %p and %p\n", 
+                check_error("Adjacent free blocks: %p and %p\n", 
                     prev, bp);
             }
         }
@@ -865,13 +1922,15 @@ void mm_checkheap(int verbose) {
         checkblock(bp);//checks for header/footer mismatch.
         //Check for next/prev pointer inconsistencies in free blocks.
         if (!GET_ALLOC(HDRP(bp))) {
+            if (bp != heap->wilderness)
+                nfree++;
             if (GET_FREE(NEXT_FREE(bp)) != NULL && 
                 GET_FREE(PREV_FREE(GET_FREE(NEXT_FREE(bp)))) != bp) {
-                printf("Free block %p's next pointer is incorrect\n", bp);
+                check_error("Free block %p's next pointer is incorrect\n", bp);
             }
             if (GET_FREE(PREV_FREE(bp)) != NULL && 
                 GET_FREE(NEXT_FREE(GET_FREE(PREV_FREE(bp)))) != bp) {
-                printf("Free block %p's prev pointer is incorrect\n", bp);
+                check_error("Free block %p's prev pointer is incorrect\n", bp);
             }
         }
     }
@@ -879,10 +1938,132 @@ void mm_checkheap(int verbose) {
     if (verbose)
         printblock(bp, 0);
     if ((GET_SIZE(HDRP(bp)) != 0) || !(GET_ALLOC(HDRP(bp))))
-        printf("Bad epilogue header\n");
+        check_error("Bad epilogue header\n");
+    //The block before the epilogue is the wilderness exactly if it is free.
+    if (prev != NULL && !GET_ALLOC(HDRP(prev)) && prev != heap->wilderness)
+        check_error("Free block %p at the top is not the wilderness\n", prev);
+    if (heap->wilderness != NULL && heap->wilderness != prev)
+        check_error("Wilderness %p is not the last block\n", heap->wilderness);
+    //Above zero_start, the wilderness holds nothing but zeros.
+    if (heap->wilderness != NULL) {
+        for (char *p = MAX(heap->zero_start, heap->wilderness);
+             p < (char *)FTRP(heap->wilderness); p++) {
+            if (*p != 0) {
+                check_error("Wilderness byte %p above %p is not zero\n",
+                    p, heap->zero_start);
+                break;
+            }
+        }
+    }
 
+    //Every free block but the wilderness is on exactly one seg list.
     for (int i = 0; i < NUM_SEGS; i++) {
-        print_free_list(i*FREE_PTR_SIZE, 1);
+        nlisted += print_free_list(i, verbose);
     }
-        
+    if (nlisted != nfree)
+        check_error("Seg lists hold %d blocks, the heap %d free ones\n",
+            nlisted, nfree);
+
+    check_quick_lists();
+    return check_errors;
+}
+
+#ifdef MM_INTERNALS
+/*
+ * Entry points for the microbenchmarks and tools; see mm-internals.h.
+ */
+
+size_t mm_block_size(size_t size) {
+    return adjust_size(size);
+}
+
+int mm_num_classes(void) {
+    return NUM_SEGS;
+}
+
+size_t mm_class_max(int i) {
+    return class_max[i];
 }
+
+int mm_class_of(size_t asize) {
+    return class_of(asize);
+}
+
+void *mm_extend_heap(size_t words) {
+    return extend_heap(words);
+}
+
+void *mm_coalesce_block(void *bp) {
+    size_t size = GET_SIZE(HDRP(bp));
+    PUT_TAG(HDRP(bp), PACK(size, 0));
+    PUT_TAG(FTRP(bp), PACK(size, 0));
+    return coalesce(bp);
+}
+
+void *mm_splice_block(void *bp) {
+    return splice_block(bp);
+}
+
+void mm_consolidate(void) {
+    consolidate();
+}
+
+void mm_get_params(mm_params_t *params) {
+    int i;
+    params->nbounds = NUM_SEGS - 1;
+    for (i = 0; i < NUM_SEGS - 1; i++)
+        params->class_max[i] = class_max[i];
+    params->chunksize = CHUNKSIZE;
+    params->search_depth = SEARCH_DEPTH;
+}
+
+static const char *fit_names[] = {
+    "first", "next", "best", "good", "adaptive", NULL
+};
+
+const char *mm_fit_policy_name(int i) {
+    return (i >= 0 && i <= FIT_ADAPTIVE) ? fit_names[i] : NULL;
+}
+
+const char *mm_fit_policy(void) {
+    return fit_names[fit_policy];
+}
+
+int mm_set_fit_policy(const char *name) {
+    int i;
+    for (i = 0; fit_names[i]; i++) {
+        if (strcmp(name, fit_names[i]) == 0) {
+            fit_policy = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void mm_get_fit_stats(mm_fit_stats_t *stats) {
+    *stats = fit_stats;
+    stats->grow_size = heap->grow_size;
+    stats->depth = (fit_policy == FIT_ADAPTIVE) ? heap->adapt_depth :
+        (fit_policy == FIT_GOOD) ? SEARCH_DEPTH : 0;
+}
+
+void mm_reset_fit_stats(void) {
+    memset(&fit_stats, 0, sizeof(fit_stats));
+}
+
+#ifdef MM_TUNABLE
+void mm_set_params(const mm_params_t *params) {
+    int i, c;
+    for (i = 0; i < NUM_SEGS - 1; i++)
+        class_max[i] = params->class_max[i];
+    /* regenerate the table the compiler built for the old bounds */
+    for (i = 0; i <= CLASS_TABLE_LEN; i++) {
+        for (c = 0; (size_t)i * ALIGNMENT > class_max[c]; c++)
+            ;
+        class_table[i] = c;
+    }
+    tune_chunksize = params->chunksize;
+    tune_search_depth = params->search_depth;
+}
+#endif
+#endif /* def MM_INTERNALS */
@@ -7,6 +7,13 @@ extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
 extern void *mm_calloc (size_t nmemb, size_t size);
+extern void *mm_memalign(size_t alignment, size_t size);
+extern int mm_posix_memalign(void **memptr, size_t alignment, size_t size);
+extern void *mm_aligned_alloc(size_t alignment, size_t size);
+extern void mm_free_sized(void *ptr, size_t size);
+extern size_t mm_malloc_usable_size(void *ptr);
+extern size_t mm_malloc_batch(size_t size, size_t n, void **out);
+extern void mm_free_batch(void **ptrs, size_t n);
 
 #else
 
@@ -15,11 +22,55 @@ extern void *malloc (size_t size);
 extern void free (void *ptr);
 extern void *realloc(void *ptr, size_t size);
 extern void *calloc (size_t nmemb, size_t size);
+extern void *memalign(size_t alignment, size_t size);
+extern int posix_memalign(void **memptr, size_t alignment, size_t size);
+extern void *aligned_alloc(size_t alignment, size_t size);
+extern void free_sized(void *ptr, size_t size);
+extern size_t malloc_usable_size(void *ptr);
+extern size_t malloc_batch(size_t size, size_t n, void **out);
+extern void free_batch(void **ptrs, size_t n);
 
 #endif
 
 extern int mm_init(void);
 
+/* Heaps of their own, dropped whole by mm_heap_destroy */
+typedef struct mm_heap mm_heap_t;
+extern mm_heap_t *mm_heap_create(void);
+extern void mm_heap_destroy(mm_heap_t *h);
+extern void *mm_heap_malloc(mm_heap_t *h, size_t size);
+extern void mm_heap_free(mm_heap_t *h, void *ptr);
+extern void *mm_heap_realloc(mm_heap_t *h, void *ptr, size_t size);
+extern void *mm_heap_calloc(mm_heap_t *h, size_t nmemb, size_t size);
+extern int mm_heap_checkheap(mm_heap_t *h, int verbose);
+
+/* Regions: bump allocation from the heap, freed all at once */
+typedef struct mm_region mm_region_t;
+extern mm_region_t *mm_region_begin(void);
+extern void *mm_region_alloc(mm_region_t *r, size_t size);
+extern void mm_region_reset(mm_region_t *r);
+extern void mm_region_end(mm_region_t *r);
+
+/* Pools of objects of one size, see mm_pool_create */
+typedef struct mm_pool mm_pool_t;
+typedef struct {
+    size_t obj_size;          /* object size, rounded up to the alignment */
+    size_t slab_size;
+    size_t slabs;             /* slabs the pool holds now */
+    size_t capacity;          /* objects they hold */
+    size_t in_use;            /* objects allocated now */
+    size_t peak;              /* most objects allocated at once */
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long slabs_freed; /* empty slabs given back to the heap */
+} mm_pool_stats_t;
+extern mm_pool_t *mm_pool_create(size_t obj_size, size_t align);
+extern void *mm_pool_alloc(mm_pool_t *p);
+extern void mm_pool_free(mm_pool_t *p, void *obj);
+extern void mm_pool_stats(mm_pool_t *p, mm_pool_stats_t *st);
+extern void mm_pool_destroy(mm_pool_t *p);
+
 /* This is largely for debugging.  You can do what you want with the
-   verbose flag; we don't care. */
-extern void mm_checkheap(int verbose);
+   verbose flag; we don't care. Returns the number of problems found,
+   which the driver counts as errors. */
+extern int mm_checkheap(int verbose);
@@ -0,0 +1,17 @@
+/*
+ * perfctr.h - Hardware cache-miss counter for the calling thread
+ *
+ * The counter counts user-mode cache misses (PERF_COUNT_HW_CACHE_MISSES)
+ * from the moment it is opened. When the kernel allows it, reads are done
+ * with rdpmc and never enter the kernel.
+ */
+
+/* Open the counter; return 0 on success, -1 if the machine or the
+   kernel does not let us count */
+int perfctr_open(void);
+
+/* Number of misses since perfctr_open */
+double perfctr_read(void);
+
+/* Release the counter */
+void perfctr_close(void);
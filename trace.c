@@ -0,0 +1,281 @@
+/*
+ * trace.c - Reading the .rep trace files
+ *
+ * A trace starts with four header lines (weight, number of block ids,
+ * number of requests, ignore-ranges flag) followed by one request per
+ * line:
+ *     a <id> <size>          malloc
+ *     r <id> <size>          realloc
+ *     f <id>                 free
+ *     s <id> <size>          free_sized, size as the block was asked for
+ *     m <id> <align> <size>  memalign
+ *     A <id> <n> <size>      malloc_batch of ids id..id+n-1
+ *     F <id> <n>             free_batch of ids id..id+n-1
+ *
+ * Shared by the driver and the trace tools. trace_replay runs a trace
+ * straight through mm.c for mm-tune and mm-tracestat.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+#include "mm.h"
+#include "memlib.h"
+
+/*
+ * app_error - Report an error in the trace file and give up
+ */
+static void app_error(const char *fmt, ...)
+    __attribute__((format(printf, 1,2), noreturn));
+
+static void app_error(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    exit(1);
+}
+
+/*
+ * unix_error - Report the error and its errno, and give up
+ */
+static void unix_error(const char *fmt, ...)
+    __attribute__((format(printf, 1,2), noreturn));
+
+static void unix_error(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    printf(": %s\n", strerror(errno));
+    va_end(ap);
+    exit(1);
+}
+
+/*
+ * read_trace - read a trace file and store it in memory
+ */
+trace_t *read_trace(const char *tracedir, const char *filename)
+{
+    FILE *tracefile;
+    trace_t *trace;
+    char type[MAXLINE];
+    int index;
+    size_t size;
+    int max_index = 0;
+    int op_index;
+
+    /* Allocate the trace record */
+    if ((trace = (trace_t *) malloc(sizeof(trace_t))) == NULL)
+        unix_error("malloc 1 failed in read_trace");
+
+    /* Read the trace file header */
+    strcpy(trace->filename, tracedir);
+    strcat(trace->filename, filename);
+    if ((tracefile = fopen(trace->filename, "r")) == NULL) {
+        unix_error("Could not open %s in read_trace", trace->filename);
+    }
+    fscanf(tracefile, "%d", &trace->weight);
+    fscanf(tracefile, "%d", &trace->num_ids);
+    fscanf(tracefile, "%d", &trace->num_ops);
+    fscanf(tracefile, "%d", &trace->ignore_ranges);
+
+    if(trace->weight < 0 || trace->weight > 3) {
+        app_error("%s: weight can only be in {0, 1, 2 3}", trace->filename);
+    }
+    if(trace->ignore_ranges != 0 && trace->ignore_ranges != 1) {
+        app_error("%s: ignore-ranges can only be zero or one", trace->filename);
+    }
+
+    /* We'll store each request line in the trace in this array */
+    if ((trace->ops =
+         (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
+        unix_error("malloc 2 failed in read_trace");
+
+    /* We'll keep an array of pointers to the allocated blocks here... */
+    if ((trace->blocks =
+         (char **)calloc(trace->num_ids, sizeof(char *))) == NULL)
+        unix_error("malloc 3 failed in read_trace");
+
+    /* ... along with the corresponding byte sizes of each block */
+    if ((trace->block_sizes =
+         (size_t *)calloc(trace->num_ids,  sizeof(size_t))) == NULL)
+        unix_error("malloc 4 failed in read_trace");
+
+    /* and, if we're debugging, the offset into the random data */
+    if ((trace->block_rand_base =
+         calloc(trace->num_ids, sizeof(*trace->block_rand_base))) == NULL)
+        unix_error("malloc 5 failed in read_trace");
+
+
+    /* read every request line in the trace file */
+    index = 0;
+    op_index = 0;
+    while (fscanf(tracefile, "%s", type) != EOF) {
+        switch(type[0]) {
+        case 'a':
+            fscanf(tracefile, "%u %zu", &index, &size);
+            trace->ops[op_index].type = ALLOC;
+            trace->ops[op_index].index = index;
+            trace->ops[op_index].size = size;
+            max_index = (index > max_index) ? index : max_index;
+            break;
+        case 'r':
+            fscanf(tracefile, "%u %zu", &index, &size);
+            trace->ops[op_index].type = REALLOC;
+            trace->ops[op_index].index = index;
+            trace->ops[op_index].size = size;
+            max_index = (index > max_index) ? index : max_index;
+            break;
+        case 'm':
+            fscanf(tracefile, "%u %zu %zu", &index,
+                   &trace->ops[op_index].align, &size);
+            trace->ops[op_index].type = MEMALIGN;
+            trace->ops[op_index].index = index;
+            trace->ops[op_index].size = size;
+            max_index = (index > max_index) ? index : max_index;
+            break;
+        case 'f':
+            fscanf(tracefile, "%ud", &index);
+            trace->ops[op_index].type = FREE;
+            trace->ops[op_index].index = index;
+            break;
+        case 's':
+            fscanf(tracefile, "%u %zu", &index, &size);
+            trace->ops[op_index].type = FREE_SIZED;
+            trace->ops[op_index].index = index;
+            trace->ops[op_index].size = size;
+            break;
+        case 'A':
+            fscanf(tracefile, "%u %d %zu", &index,
+                   &trace->ops[op_index].count, &size);
+            trace->ops[op_index].type = BATCH_ALLOC;
+            trace->ops[op_index].index = index;
+            trace->ops[op_index].size = size;
+            index += trace->ops[op_index].count - 1;
+            max_index = (index > max_index) ? index : max_index;
+            break;
+        case 'F':
+            fscanf(tracefile, "%u %d", &index, &trace->ops[op_index].count);
+            trace->ops[op_index].type = BATCH_FREE;
+            trace->ops[op_index].index = index;
+            break;
+        default:
+            app_error("Bogus type character (%c) in tracefile %s\n",
+                      type[0], trace->filename);
+        }
+        op_index++;
+        if(op_index == trace->num_ops) break;
+    }
+    fclose(tracefile);
+    assert(max_index == trace->num_ids - 1);
+    assert(trace->num_ops == op_index);
+
+    return trace;
+}
+
+/*
+ * reinit_trace - get the trace ready for another run.
+ */
+void reinit_trace(trace_t *trace)
+{
+    memset(trace->blocks, 0, trace->num_ids * sizeof(*trace->blocks));
+    memset(trace->block_sizes, 0, trace->num_ids * sizeof(*trace->block_sizes));
+    /* block_rand_base is unused if size is zero */
+}
+
+/*
+ * free_trace - Free the trace record and the four arrays it points
+ *              to, all of which were allocated in read_trace().
+ */
+void free_trace(trace_t *trace)
+{
+    free(trace->ops);         /* free the three arrays... */
+    free(trace->blocks);
+    free(trace->block_sizes);
+    free(trace->block_rand_base);
+    free(trace);              /* and the trace record itself... */
+}
+
+/*
+ * trace_replay - Run the trace through mm.c on a fresh heap and store
+ *     the payload high-water mark in *hwm; return 0, or -1 if a request
+ *     failed
+ */
+int trace_replay(trace_t *trace, long *hwm)
+{
+    long total = 0;
+    int i, k, n, index;
+    size_t size;
+    char *p;
+
+    *hwm = 0;
+    reinit_trace(trace);
+    mem_reset_brk();
+    if (mm_init() < 0)
+        return -1;
+
+    for (i = 0; i < trace->num_ops; i++) {
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+
+        switch (trace->ops[i].type) {
+        case ALLOC:
+        case MEMALIGN:
+            p = (trace->ops[i].type == MEMALIGN) ?
+                mm_memalign(trace->ops[i].align, size) : mm_malloc(size);
+            if (p == NULL)
+                return -1;
+            trace->blocks[index] = p;
+            trace->block_sizes[index] = size;
+            total += size;
+            break;
+
+        case REALLOC:
+            if ((p = mm_realloc(trace->blocks[index], size)) == NULL &&
+                size != 0)
+                return -1;
+            total += size - trace->block_sizes[index];
+            trace->blocks[index] = p;
+            trace->block_sizes[index] = size;
+            break;
+
+        case FREE:
+            if (index < 0) {
+                mm_free(NULL);
+                break;
+            }
+            mm_free(trace->blocks[index]);
+            total -= trace->block_sizes[index];
+            break;
+
+        case FREE_SIZED:
+            mm_free_sized(trace->blocks[index], size);
+            total -= trace->block_sizes[index];
+            break;
+
+        case BATCH_ALLOC:
+            n = trace->ops[i].count;
+            if (mm_malloc_batch(size, n, (void **)&trace->blocks[index]) !=
+                (size_t)n)
+                return -1;
+            for (k = index; k < index + n; k++)
+                trace->block_sizes[k] = size;
+            total += n * size;
+            break;
+
+        case BATCH_FREE:
+            n = trace->ops[i].count;
+            for (k = index; k < index + n; k++)
+                total -= trace->block_sizes[k];
+            mm_free_batch((void **)&trace->blocks[index], n);
+            break;
+        }
+        if (total > *hwm)
+            *hwm = total;
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * trace.h - In-memory form of a .rep trace file
+ */
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+#include <stddef.h>
+
+#define MAXLINE     1024 /* max string size */
+#define HDRLINES       4 /* number of header lines in a trace file */
+
+/* weights: what a trace counts towards in the performance index */
+#define WNONE 0
+#define WALL 1
+#define WUTIL 2
+#define WPERF 3
+
+/* Characterizes a single trace operation (allocator request) */
+typedef struct {
+    enum { ALLOC, FREE, REALLOC, MEMALIGN,
+           BATCH_ALLOC, BATCH_FREE, FREE_SIZED } type; /* type of request */
+    int index;                        /* index for free() to use later */
+    size_t size;                      /* byte size of alloc/realloc request,
+                                         or of the block free_sized frees */
+    size_t align;                     /* alignment of a memalign request */
+    int count;                        /* ids index.. of a batch request */
+} traceop_t;
+
+/* Holds the information for one trace file*/
+typedef struct {
+    char filename[MAXLINE];
+    int ignore_ranges;   /* don't check ranges (i.e. this is too big) */
+    int num_ids;         /* number of alloc/realloc ids */
+    int num_ops;         /* number of distinct requests */
+    int weight;          /* weight for this trace (unused) */
+    traceop_t *ops;      /* array of requests */
+    char **blocks;       /* array of ptrs returned by malloc/realloc... */
+    size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+    int *block_rand_base;/* index into random_data, if debug is on */
+} trace_t;
+
+/* These functions read, allocate, and free storage for traces */
+trace_t *read_trace(const char *tracedir, const char *filename);
+void reinit_trace(trace_t *trace);
+void free_trace(trace_t *trace);
+
+/* Replays a trace through mm.c, for the tools that tune and profile it */
+int trace_replay(trace_t *trace, long *hwm);
+
+#endif /* __TRACE_H_ */